@@ -0,0 +1,187 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "../include/ast_cache.h"
+#include "../include/cache_manager.h"
+
+
+static void get_ast_cache_path(char* buffer, size_t size, const unsigned char* digest) {
+	char hex[HASH_HEX_LENGTH + 1];
+	digest_to_hex_string(digest, hex);
+	snprintf(buffer, size, "%s/%s/%s%s", CACHE_DIR, AST_CACHE_DIR, hex, AST_CACHE_SUFFIX);
+}
+
+static bool read_all(FILE* file, void* data, size_t size) {
+	return size == 0 || fread(data, 1, size, file) == size;
+}
+
+static bool write_all(FILE* file, const void* data, size_t size) {
+	return size == 0 || fwrite(data, 1, size, file) == size;
+}
+
+static bool valid_data_offset(uint32_t offset, uint64_t strings_size) {
+	return offset == AST_NONE || offset < strings_size;
+}
+
+// Children and siblings always come later in pre-order, which also rules out
+// cycles in a corrupted file.
+static bool validate_ast(const Ast* ast) {
+	if (ast->node_count == 0 || ast->nodes[0].type != NODE_DOCUMENT) return false;
+	if (ast->strings_length == 0 || ast->strings[ast->strings_length - 1] != '\0') return false;
+
+	for (size_t i = 0; i < ast->node_count; i++) {
+		const AstNode* node = &ast->nodes[i];
+		if (node->type > NODE_SOFT_BREAK) return false;
+		if (node->first_child != AST_NONE && (node->first_child <= i || node->first_child >= ast->node_count)) return false;
+		if (node->next_sibling != AST_NONE && (node->next_sibling <= i || node->next_sibling >= ast->node_count)) return false;
+		if (!valid_data_offset(node->data1, ast->strings_length)) return false;
+		if (!valid_data_offset(node->data2, ast->strings_length)) return false;
+	}
+	for (size_t i = 0; i < ast->link_count; i++) {
+		if (ast->links[i] >= ast->node_count) return false;
+		const AstNode* link = &ast->nodes[ast->links[i]];
+		if ((link->type != NODE_LINK && link->type != NODE_IMAGE_LINK) || link->data1 == AST_NONE) return false;
+	}
+	return true;
+}
+
+static Ast* read_ast_file(FILE* file) {
+	AstCacheHeader header;
+	if (!read_all(file, &header, sizeof(header))) return NULL;
+	if (memcmp(header.magic, AST_CACHE_MAGIC, sizeof(header.magic)) != 0) return NULL;
+	if (header.version != AST_CACHE_FORMAT_VERSION || header.parser_version != PARSER_VERSION) return NULL;
+	if (header.node_size != sizeof(AstNode)) return NULL;
+
+	struct stat st;
+	size_t nodes_size = (size_t)header.node_count * sizeof(AstNode);
+	size_t links_size = (size_t)header.link_count * sizeof(AstNodeId);
+	if (fstat(fileno(file), &st) != 0) return NULL;
+	if ((uint64_t)st.st_size != sizeof(header) + nodes_size + links_size + header.strings_size) return NULL;
+
+	Ast* ast = calloc(1, sizeof(Ast));
+	if (!ast) return NULL;
+	ast->node_count = header.node_count;
+	ast->link_count = header.link_count;
+	ast->strings_length = header.strings_size;
+	ast->strings_capacity = header.strings_size > 0 ? header.strings_size : 1;
+	ast->nodes = malloc(nodes_size > 0 ? nodes_size : 1);
+	ast->links = malloc(links_size > 0 ? links_size : 1);
+	ast->strings = malloc(ast->strings_capacity);
+
+	bool ok = ast->nodes && ast->links && ast->strings
+		&& read_all(file, ast->nodes, nodes_size)
+		&& read_all(file, ast->links, links_size)
+		&& read_all(file, ast->strings, header.strings_size);
+	if (ok) {
+		uint64_t checksum = fnv1a(ast->nodes, nodes_size);
+		checksum = fnv1a_update(checksum, ast->links, links_size);
+		checksum = fnv1a_update(checksum, ast->strings, header.strings_size);
+		ok = checksum == header.checksum && validate_ast(ast);
+	}
+	if (!ok) {
+		free_ast(ast);
+		return NULL;
+	}
+	return ast;
+}
+
+Ast* load_cached_ast(const unsigned char* digest) {
+	char path[256];
+	get_ast_cache_path(path, sizeof(path), digest);
+
+	FILE* file = fopen(path, "rb");
+	if (!file) return NULL;
+	Ast* ast = read_ast_file(file);
+	fclose(file);
+	return ast;
+}
+
+void store_cached_ast(const unsigned char* digest, const Ast* ast) {
+	char directory[256];
+	char path[256];
+	char temp_path[256];
+	snprintf(directory, sizeof(directory), "%s/%s", CACHE_DIR, AST_CACHE_DIR);
+	get_ast_cache_path(path, sizeof(path), digest);
+	snprintf(temp_path, sizeof(temp_path), "%s/%s/tmp-XXXXXX", CACHE_DIR, AST_CACHE_DIR);
+
+	if (check_path_type(directory) != 2 && mkdir_p(directory) != 0) return;
+
+	// pages with the same text write the same file, so each writer gets its
+	// own temporary and the last rename wins
+	int fd = mkstemp(temp_path);
+	if (fd < 0) return;
+	FILE* file = fdopen(fd, "wb");
+	if (!file) {
+		close(fd);
+		remove(temp_path);
+		return;
+	}
+
+	size_t nodes_size = ast->node_count * sizeof(AstNode);
+	size_t links_size = ast->link_count * sizeof(AstNodeId);
+
+	AstCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, AST_CACHE_MAGIC, sizeof(header.magic));
+	header.version = AST_CACHE_FORMAT_VERSION;
+	header.parser_version = PARSER_VERSION;
+	header.node_size = sizeof(AstNode);
+	header.node_count = (uint32_t)ast->node_count;
+	header.link_count = (uint32_t)ast->link_count;
+	header.strings_size = ast->strings_length;
+	header.checksum = fnv1a(ast->nodes, nodes_size);
+	header.checksum = fnv1a_update(header.checksum, ast->links, links_size);
+	header.checksum = fnv1a_update(header.checksum, ast->strings, ast->strings_length);
+
+	bool ok = write_all(file, &header, sizeof(header))
+		&& write_all(file, ast->nodes, nodes_size)
+		&& write_all(file, ast->links, links_size)
+		&& write_all(file, ast->strings, ast->strings_length);
+	ok = (fclose(file) == 0) && ok;
+
+	if (!ok || rename(temp_path, path) != 0) {
+		fprintf(stderr, "Warning: Failed to write AST cache file: %s\n", path);
+		remove(temp_path);
+	}
+}
+
+void prune_ast_cache(const HashTable* cache) {
+	char directory[256];
+	snprintf(directory, sizeof(directory), "%s/%s", CACHE_DIR, AST_CACHE_DIR);
+	DIR* dir = opendir(directory);
+	if (!dir || !cache) {
+		if (dir) closedir(dir);
+		return;
+	}
+
+	HashTable* live = ht_create(cache->size > 0 ? cache->size : 1);
+	for (size_t i = 0; i < cache->size; i++) {
+		for (HashEntry* entry = cache->entries[i]; entry; entry = entry->next) {
+			const CacheEntry* cache_entry = entry->value;
+			char name[HASH_HEX_LENGTH + sizeof(AST_CACHE_SUFFIX)];
+			digest_to_hex_string(cache_entry->digest, name);
+			strcat(name, AST_CACHE_SUFFIX);
+			ht_set(live, name, (void*)cache_entry);
+		}
+	}
+
+	size_t removed = 0;
+	struct dirent* dirent;
+	while ((dirent = readdir(dir)) != NULL) {
+		if (dirent->d_name[0] == '.' || ht_get(live, dirent->d_name)) continue;
+
+		char path[512];
+		snprintf(path, sizeof(path), "%s/%s", directory, dirent->d_name);
+		if (remove(path) == 0) removed++;
+	}
+	closedir(dir);
+	ht_destroy(live, NULL);
+
+	if (removed > 0) {
+		printf("Pruned %zu stale AST cache file(s).\n", removed);
+	}
+}
@@ -4,6 +4,8 @@
 #include <sys/stat.h>
 #include <ctype.h>
 #include <stdbool.h>
+#include <pthread.h>
+#include <time.h>
 
 #include "../include/build_process.h"
 #include "../include/list_head.h"
@@ -15,18 +17,16 @@
 #include "../include/file_utils.h"
 #include "../include/hash_utils.h"
 #include "../include/hash_table.h"
+#include "../include/cache_manager.h"
+#include "../include/ast_cache.h"
+#include "../include/dependency_tracker.h"
+#include "../include/output_writer.h"
+#include "../include/link_graph.h"
 
 #define MAX_PATH_LENGTH 1024
-
-static char* trim_whitespace(char* str) {
-	while (isspace((unsigned char)*str)) str++;
-	if (*str == 0) return str;
-
-	char *end = str + strlen(str) - 1;
-	while (end > str && isspace((unsigned char)*end)) end--;
-	end[1] = '\0';
-	return str;
-}
+// parsed Asts kept in memory between collecting links and rendering; past
+// this, process_file reads them back from the AST cache instead
+#define KEPT_AST_BUDGET ((size_t)16 << 20)
 
 int compare_posts(const void* a, const void* b) {
 	const PostSortInfo* postA = (const PostSortInfo*)a;
@@ -53,74 +53,367 @@ int compare_posts(const void* a, const void* b) {
 	return 0;
 }
 
-void extract_sort_info(const char* file_path, PostSortInfo* info) {
-	info->id = 0;
-	info->order = 0;
-	info->date = strdup("9999-99-99");
-	info->has_order = false;
+static void fill_sort_info(NavNode* node, PostSortInfo* info) {
+	info->node = node;
+	info->id = node->meta.id;
+	info->order = node->meta.order;
+	info->has_order = node->meta.has_order;
+	info->date = strdup(node->meta.date ? node->meta.date : "9999-99-99");
+}
 
-	FILE* file = fopen(file_path, "r");
-	if (!file) return;
+typedef struct {
+	NavNode* node;
+	NavNode* prev_node;
+	NavNode* next_node;
+	NavNode* first_node;
+	const char* series_name;
+
+	// wikilink targets of the page, filled by collect_page_links; those linked
+	// with a #heading or ^block fragment are in anchored_links as well
+	const LinkTarget** links;
+	size_t link_count;
+	const LinkTarget** anchored_links;
+	size_t anchored_link_count;
+
+	// heading and block ids of the page, see collect_page_anchors
+	char** anchors;
+	size_t anchor_count;
+	bool anchors_collected;
+	bool anchors_needed;
+
+	// a note collect_page_links had to parse, rendered from here by
+	// process_file if it fit in KEPT_AST_BUDGET
+	Ast* ast;
+
+	// filled by process_file, merged into new_cache in queue order
+	char* cache_key;
+	CacheEntry* cache_entry;
+} BuildJob;
+
+typedef struct {
+	BuildJob* jobs;
+	size_t count;
+	size_t capacity;
+} BuildQueue;
+
+// read-only state shared by every render job
+typedef struct {
+	const char* vault_path;
+	SiteContext* s_context;
+	TemplateContext* global_context;
+	BuildCache* old_cache;
+	const BuildOptions* options;
+	time_t started_at;
+
+	// template path -> digest, shared by the dependency checks of all jobs
+	HashTable* template_digests;
+	pthread_mutex_t* template_digests_lock;
+
+	// bytes of the Asts kept on jobs, see KEPT_AST_BUDGET
+	size_t* kept_ast_bytes;
+	pthread_mutex_t* kept_ast_lock;
+
+	// complete before the first page renders
+	LinkGraph* link_graph;
+} BuildEnv;
+
+typedef void (*JobFunction)(const BuildEnv* env, BuildJob* job);
+
+typedef struct {
+	const BuildEnv* env;
+	BuildQueue* queue;
+	JobFunction run;
+
+	size_t next_job;
+	pthread_mutex_t lock;
+} WorkerPool;
+
+static void build_site_recursively(const BuildEnv* env, NavNode* node, BuildQueue* queue, struct list_head* all_posts, HashTable* new_cache);
+static void process_file(const BuildEnv* env, BuildJob* job);
+static void collect_page_links(const BuildEnv* env, BuildJob* job);
+static void collect_page_anchors(const BuildEnv* env, BuildJob* job);
+static void mark_anchored_notes(const LinkResolver* resolver, BuildQueue* queue);
+static const char* find_changed_dependency(const BuildEnv* env, const BuildJob* job, const CacheRecord* record);
+static void copy_cached_dependencies(const BuildCache* cache, const CacheRecord* record, DependencyList* list);
+
+static void enqueue_job(BuildQueue* queue, struct list_head* all_posts, NavNode* node, NavNode* prev_node, NavNode* next_node, NavNode* first_node, const char* series_name) {
+	if (queue->count == queue->capacity) {
+		queue->capacity = queue->capacity ? queue->capacity * 2 : 64;
+		queue->jobs = realloc(queue->jobs, queue->capacity * sizeof(BuildJob));
+	}
 
-	char line[MAX_PATH_LENGTH];
-	if (!fgets(line, sizeof(line), file) || strncmp(line, "---", 3) != 0) {
-		fclose(file);
+	BuildJob* job = &queue->jobs[queue->count++];
+	job->node = node;
+	job->prev_node = prev_node;
+	job->next_node = next_node;
+	job->first_node = first_node;
+	job->series_name = series_name;
+	job->links = NULL;
+	job->link_count = 0;
+	job->anchored_links = NULL;
+	job->anchored_link_count = 0;
+	job->anchors = NULL;
+	job->anchor_count = 0;
+	job->anchors_collected = false;
+	job->anchors_needed = false;
+	job->ast = NULL;
+	job->cache_key = NULL;
+	job->cache_entry = NULL;
+
+	PostSortInfo* post_info = malloc(sizeof(PostSortInfo));
+	fill_sort_info(node, post_info);
+	list_add_tail(&post_info->list, all_posts);
+}
+
+static void* render_worker(void* arg) {
+	WorkerPool* pool = (WorkerPool*)arg;
+
+	while (true) {
+		pthread_mutex_lock(&pool->lock);
+		size_t index = pool->next_job++;
+		pthread_mutex_unlock(&pool->lock);
+
+		if (index >= pool->queue->count) break;
+		pool->run(pool->env, &pool->queue->jobs[index]);
+	}
+	return NULL;
+}
+
+// Runs `run` once for every job, on up to `jobs` threads.
+static void run_queue(const BuildEnv* env, BuildQueue* queue, int jobs, JobFunction run) {
+	if (jobs > (int)queue->count) jobs = (int)queue->count;
+
+	if (jobs <= 1) {
+		for (size_t i = 0; i < queue->count; i++) {
+			run(env, &queue->jobs[i]);
+		}
 		return;
 	}
 
-	while (fgets(line, sizeof(line), file) && strncmp(line, "---", 3) != 0) {
-		char* key = strtok(line, ":");
-		char* value_str = strtok(NULL, "\n");
-		if (key && value_str) {
-			char* trimmed_key = trim_whitespace(key);
-			char* trimmed_value = trim_whitespace(value_str);
-			if (strcmp(trimmed_key, "id") == 0) info->id = atoi(trimmed_value);
-			if (strcmp(trimmed_key, "order") == 0) {
-				info->order = atoi(trimmed_value);
-				info->has_order = true;
-			}
-			if (strcmp(trimmed_key, "date") == 0) {
-				free(info->date);
-				info->date = strdup(trimmed_value);
-			}
+	WorkerPool pool = {
+		.env = env,
+		.queue = queue,
+		.run = run,
+		.next_job = 0,
+	};
+	pthread_mutex_init(&pool.lock, NULL);
+
+	pthread_t* threads = malloc(jobs * sizeof(pthread_t));
+	int started = 0;
+	for (int i = 0; i < jobs; i++) {
+		if (pthread_create(&threads[started], NULL, render_worker, &pool) != 0) {
+			fprintf(stderr, "[WARN] Failed to start render thread %d, continuing with %d.\n", i, started);
+			break;
 		}
+		started++;
+	}
+	if (started == 0) {
+		render_worker(&pool);
 	}
-	fclose(file);
+	for (int i = 0; i < started; i++) {
+		pthread_join(threads[i], NULL);
+	}
+
+	free(threads);
+	pthread_mutex_destroy(&pool.lock);
 }
 
-static char* parse_front_matter(FILE* file, TemplateContext* context) {
-	char line[MAX_PATH_LENGTH];
-	fseek(file, 0, SEEK_SET);
-	if (!fgets(line, sizeof(line), file) || strncmp(line, "---", 3) != 0) {
-		fseek(file, 0, SEEK_SET);
-		return NULL;
+static void write_link_graph(const BuildEnv* env, const BuildCache* old_cache, HashTable* new_cache) {
+	const char* output_dir = get_from_context(env->global_context, "build.output_dir");
+	char output_path[MAX_PATH_LENGTH];
+	snprintf(output_path, sizeof(output_path), "%s/%s", output_dir ? output_dir : "ssg_output", LINK_GRAPH_FILE);
+
+	char* json_text = link_graph_to_json(env->link_graph);
+	OutputStatus status = write_generated_output(old_cache, new_cache, output_path, json_text);
+	if (status != OUTPUT_FAILED) {
+		printf("Generated link graph (%zu links, %s): %s\n", env->link_graph->edge_count, output_status_name(status), output_path);
 	}
+	free(json_text);
+}
+
+void build_site(const char* vault_path, SiteContext* s_context, TemplateContext* global_context, BuildCache* old_cache, HashTable* new_cache, struct list_head* all_posts, const BuildOptions* options) {
+	int jobs = (options && options->jobs > 0) ? options->jobs : 1;
+	BuildQueue queue = { NULL, 0, 0 };
+	pthread_mutex_t template_digests_lock = PTHREAD_MUTEX_INITIALIZER;
+	size_t kept_ast_bytes = 0;
+	pthread_mutex_t kept_ast_lock = PTHREAD_MUTEX_INITIALIZER;
+	BuildEnv env = {
+		.vault_path = vault_path,
+		.s_context = s_context,
+		.global_context = global_context,
+		.old_cache = old_cache,
+		.options = options,
+		.started_at = time(NULL),
+		.template_digests = ht_create(64),
+		.template_digests_lock = &template_digests_lock,
+		.kept_ast_bytes = &kept_ast_bytes,
+		.kept_ast_lock = &kept_ast_lock,
+	};
 
-	while (fgets(line, sizeof(line), file) && strncmp(line, "---", 3) != 0) {
-		char* key = strtok(line, ":");
-		char* value = strtok(NULL, "\n");
-		if (key && value) {
-			add_to_context(context, trim_whitespace(key), trim_whitespace(value));
+	printf("\n---- STARTING SITE GENERATION ----\n");
+	build_site_recursively(&env, s_context->root, &queue, all_posts, new_cache);
+
+	// backlinks need every page's links before any page renders, and
+	// [[note#heading]] links the anchors of the notes they point into
+	printf("Collecting links of %zu pages...\n", queue.count);
+	run_queue(&env, &queue, jobs, collect_page_links);
+	mark_anchored_notes(s_context->link_resolver, &queue);
+	run_queue(&env, &queue, jobs, collect_page_anchors);
+
+	env.link_graph = create_link_graph(s_context->link_resolver);
+	for (size_t i = 0; i < queue.count; i++) {
+		BuildJob* job = &queue.jobs[i];
+		const LinkTarget* source = link_target_of_node(s_context->link_resolver, job->node);
+		for (size_t j = 0; j < job->link_count; j++) {
+			add_link_edge(env.link_graph, source, job->links[j]);
 		}
+		for (size_t j = 0; j < job->anchor_count; j++) {
+			add_link_anchor(s_context->link_resolver, source, job->anchors[j]);
+			free(job->anchors[j]);
+		}
+		free(job->anchors);
+		free(job->anchored_links);
 	}
+	finish_link_graph(env.link_graph);
+
+	printf("Rendering %zu pages with %d job(s)...\n", queue.count, jobs);
+	run_queue(&env, &queue, jobs, process_file);
 
-	DynamicBuffer* db = create_dynamic_buffer(0);
-	while (fgets(line, sizeof(line), file)) {
-		buffer_append_formatted(db, "%s", line);
+	write_link_graph(&env, old_cache, new_cache);
+
+	for (size_t i = 0; i < queue.count; i++) {
+		BuildJob* job = &queue.jobs[i];
+		free(job->links);
+		if (job->cache_key && job->cache_entry) {
+			ht_set(new_cache, job->cache_key, job->cache_entry);
+		} else {
+			free_cache_entry(job->cache_entry);
+		}
+		free(job->cache_key);
 	}
-	return destroy_buffer_and_get_content(db);
+	free(queue.jobs);
+	ht_destroy(env.template_digests, free);
+	free_link_graph(env.link_graph);
+	printf("\n---- SITE GENERATION FINISHED ----\n\n");
 }
 
-static void build_site_recursively(const char* vault_path, NavNode* node, SiteContext* s_context, TemplateContext* global_context, HashTable* old_cache, HashTable* new_cache, struct list_head* all_posts);
-static void process_file(const char* vault_path, NavNode* current_node, SiteContext* s_context, TemplateContext* global_context, HashTable* old_cache, HashTable* new_cache, struct list_head* all_posts, NavNode* prev_node, NavNode* next_node, NavNode* first_node, const char* series_name);
+// Identifies what a category page shows: the subtree digest from the scan
+// (note names and metadata) plus the notes that survived .ssgignore.
+static void category_page_digest(const NavNode* node, PostSortInfo* sort_array, int post_count, unsigned char* digest) {
+	DynamicBuffer* buffer = create_dynamic_buffer(1024);
+	buffer_append_bytes(buffer, node->tree_digest, HASH_DIGEST_SIZE);
+	for (int i = 0; i < post_count; i++) {
+		buffer_append_bytes(buffer, sort_array[i].node->full_path, strlen(sort_array[i].node->full_path) + 1);
+	}
+	generate_buffer_digest(buffer->content, buffer->length, digest);
+	free(destroy_buffer_and_get_content(buffer));
+}
 
-void build_site(const char* vault_path, SiteContext* s_context, TemplateContext* global_context, HashTable* old_cache, HashTable* new_cache, struct list_head* all_posts) {
-	printf("\n---- STARTING SITE GENERATION ----\n");
-	build_site_recursively(vault_path, s_context->root, s_context, global_context, old_cache, new_cache, all_posts);
-	printf("\n---- SITE GENERATION FINISHED ----\n\n");
+// Renders the card list of one category, unless the previous build wrote the
+// same page and none of its recorded dependencies changed.
+static void render_category_page(const BuildEnv* env, NavNode* node, const char* category_slug, PostSortInfo* sort_array, int post_count, HashTable* new_cache) {
+	TemplateContext* global_context = env->global_context;
+	SiteContext* s_context = env->s_context;
+
+	char output_path[MAX_PATH_LENGTH];
+	const char* output_dir = get_from_context(global_context, "build.output_dir");
+	snprintf(output_path, sizeof(output_path), "%s/%s.html", output_dir ? output_dir : "ssg_output", category_slug);
+
+	char cache_key[MAX_PATH_LENGTH];
+	snprintf(cache_key, sizeof(cache_key), "%s/%s", env->vault_path, node->full_path);
+
+	unsigned char digest[HASH_DIGEST_SIZE];
+	category_page_digest(node, sort_array, post_count, digest);
+
+	const CacheRecord* old_record = cache_lookup(env->old_cache, cache_key);
+	if (old_record && memcmp(old_record->digest, digest, HASH_DIGEST_SIZE) == 0
+			&& strcmp(cache_record_output_path(env->old_cache, old_record), output_path) == 0
+			&& check_path_type(output_path) == 1 && !find_changed_dependency(env, NULL, old_record)) {
+		printf("Skipping (cached) index page: %s\n", output_path);
+		CacheEntry* entry = create_cache_entry(digest, output_path, NULL);
+		memcpy(entry->output_digest, old_record->output_digest, HASH_DIGEST_SIZE);
+		copy_cached_dependencies(env->old_cache, old_record, &entry->dependencies);
+		ht_set(new_cache, cache_key, entry);
+		return;
+	}
+
+	DependencyList dependencies;
+	dependency_list_init(&dependencies);
+	start_dependency_recording(&dependencies, global_context);
+
+	const char* base_url = get_from_context(global_context, "base_url");
+	if (!base_url) base_url = "";
+
+	DynamicBuffer* post_list_buffer = create_dynamic_buffer(1024);
+	for (int i = 0; i < post_count; i++) {
+		NavNode* sorted_child = sort_array[i].node;
+		TemplateContext* card_context = create_template_context();
+
+		char link_path[MAX_PATH_LENGTH];
+		snprintf(link_path, sizeof(link_path), "%s/%s", base_url, sorted_child->slug);
+
+		char* title_from_name = strdup(sorted_child->name);
+		char* dot = strrchr(title_from_name, '.');
+		if (dot) *dot = '\0';
+
+		add_to_context(card_context, "card_item_title", title_from_name);
+		free(title_from_name);
+
+		add_to_context(card_context, "card_item_link", link_path);
+
+		const char* preview_text = sorted_child->meta.excerpt ? sorted_child->meta.excerpt : "내용이 없습니다.";
+		add_to_context(card_context, "card_item_content", preview_text);
+
+		char* rendered_card = render_template("templates/components/card.html", card_context);
+		if (rendered_card != NULL) {
+			buffer_append_formatted(post_list_buffer, "%s", rendered_card);
+			free(rendered_card);
+		} else {
+			fprintf(stderr, "[ERROR] Template Rendered Failed!: templates/components/card.html\n");
+		}
+
+		free_template_context(card_context);
+	}
+
+	char* post_list_html = destroy_buffer_and_get_content(post_list_buffer);
+
+	TemplateContext* page_context = create_template_context();
+	copy_context(page_context, global_context);
+
+	generate_breadcrumb_html(node, page_context, s_context);
+	add_to_context(page_context, "list_title", node->name);
+	add_to_context(page_context, "title", node->name);
+	add_to_context(page_context, "post_list", post_list_html);
+
+	char* content_html = render_template("templates/layout/post_list_layout.html", page_context);
+	add_to_context(page_context, "content", content_html);
+	char* final_html = render_template("templates/layout/base.html", page_context);
+
+	stop_dependency_recording();
+
+	unsigned char output_digest[HASH_DIGEST_SIZE];
+	const unsigned char* previous_digest = cache_previous_output_digest(env->old_cache, cache_key, output_path);
+	OutputStatus status = write_output_file(output_path, final_html, strlen(final_html), previous_digest, output_digest);
+	if (status != OUTPUT_FAILED) {
+		printf("Generated index page (%s): %s\n", output_status_name(status), output_path);
+
+		CacheEntry* entry = create_cache_entry(digest, output_path, NULL);
+		memcpy(entry->output_digest, output_digest, HASH_DIGEST_SIZE);
+		entry->dependencies = dependencies;
+		dependency_list_init(&dependencies);
+		ht_set(new_cache, cache_key, entry);
+	}
+
+	free(post_list_html);
+	free(content_html);
+	free(final_html);
+	free_template_context(page_context);
+	dependency_list_free(&dependencies);
 }
 
-void build_site_recursively(const char* vault_path, NavNode* node, SiteContext* s_context, TemplateContext* global_context, HashTable* old_cache, HashTable* new_cache, struct list_head* all_posts) {
+void build_site_recursively(const BuildEnv* env, NavNode* node, BuildQueue* queue, struct list_head* all_posts, HashTable* new_cache) {
+	TemplateContext* global_context = env->global_context;
+
 	if (is_ignored(node->full_path) || (strlen(node->name) > 0 && node->name[0] == '.')) {
 		printf("[SKIP] Ignoring path: %s\n", node->full_path);
 		return;
@@ -158,85 +451,21 @@ void build_site_recursively(const char* vault_path, NavNode* node, SiteContext*
 					int current_index = 0;
 					list_for_each_entry(child, &node->children, sibling) {
 						if (!child->is_directory && strstr(child->name, ".md") && !is_ignored(child->full_path)) {
-							sort_array[current_index].node = child;
-							char full_input_path[MAX_PATH_LENGTH];
-							snprintf(full_input_path, sizeof(full_input_path), "%s/%s", vault_path, child->full_path);
-							extract_sort_info(full_input_path, &sort_array[current_index]);
+							fill_sort_info(child, &sort_array[current_index]);
 							current_index++;
 						}
 					}
 
 					qsort(sort_array, post_count, sizeof(PostSortInfo), compare_posts);
 
-					const char* base_url = get_from_context(global_context, "base_url");
-					if (!base_url) base_url = "";
-
-					DynamicBuffer* post_list_buffer = create_dynamic_buffer(1024);
-					for (int i = 0; i < post_count; i++) {
-						NavNode* sorted_child = sort_array[i].node;
-						TemplateContext* card_context = create_template_context();
-
-						char link_path[MAX_PATH_LENGTH];
-						snprintf(link_path, sizeof(link_path), "%s/%s", base_url, sorted_child->slug);
-
-						char* title_from_name = strdup(sorted_child->name);
-						char* dot = strrchr(title_from_name, '.');
-						if (dot) *dot = '\0';
-
-						add_to_context(card_context, "card_item_title", title_from_name);
-						free(title_from_name);
-
-						add_to_context(card_context, "card_item_link", link_path);
-
-						const char* preview_text = sorted_child->excerpt ? sorted_child->excerpt : "내용이 없습니다.";
-						add_to_context(card_context, "card_item_content", preview_text);
-
-						char* rendered_card = render_template("templates/components/card.html", card_context);
-						if (rendered_card != NULL) {
-							buffer_append_formatted(post_list_buffer, "%s", rendered_card);
-							free(rendered_card);
-						} else {
-							fprintf(stderr, "[ERROR] Template Rendered Failed!: templates/components/card.html\n");
-						}
-
-						free_template_context(card_context);
-					}
-
-					char* post_list_html = destroy_buffer_and_get_content(post_list_buffer);
-
-					TemplateContext* page_context = create_template_context();
-					copy_context(page_context, global_context);
-
-					generate_breadcrumb_html(node, page_context, s_context);
-					add_to_context(page_context, "list_title", node->name);
-					add_to_context(page_context, "title", node->name);
-					add_to_context(page_context, "post_list", post_list_html);
-
-					char* content_html = render_template("templates/layout/post_list_layout.html", page_context);
-					add_to_context(page_context, "content", content_html);
-					char* final_html = render_template("templates/layout/base.html", page_context);
-
-					char output_path[MAX_PATH_LENGTH];
-					const char* output_dir = get_from_context(global_context, "build.output_dir");
-					snprintf(output_path, sizeof(output_path), "%s/%s.html", output_dir ? output_dir : "ssg_output", category_slug);
-					FILE* out_file = fopen(output_path, "w");
-					if (out_file) {
-						fprintf(out_file, "%s", final_html);
-						fclose(out_file);
-						printf("Generated index page: %s\n", output_path);
-					}
-
-					free(post_list_html);
-					free(content_html);
-					free(final_html);
-					free_template_context(page_context);
+					render_category_page(env, node, category_slug, sort_array, post_count, new_cache);
 
 					for (int i = 0; i < post_count; i++) {
 						NavNode* next_node = (i > 0) ? sort_array[i-1].node : NULL;
 						NavNode* prev_node = (i < post_count - 1) ? sort_array[i + 1].node : NULL;
 						NavNode* first_node = sort_array[post_count - 1].node;
 
-						process_file(vault_path, sort_array[i].node, s_context, global_context, old_cache, new_cache, all_posts, prev_node, next_node, first_node, node->name);
+						enqueue_job(queue, all_posts, sort_array[i].node, prev_node, next_node, first_node, node->name);
 					}
 					for (int i = 0; i < post_count; i++) {
 						free(sort_array[i].date);
@@ -249,113 +478,409 @@ void build_site_recursively(const char* vault_path, NavNode* node, SiteContext*
 		NavNode* child;
 		list_for_each_entry(child, &node->children, sibling) {
 			if (child->is_directory) {
-				build_site_recursively(vault_path, child, s_context, global_context, old_cache, new_cache, all_posts);
+				build_site_recursively(env, child, queue, all_posts, new_cache);
 			}
 		}
 	} else if (strstr(node->name, ".md")) {
-		process_file(vault_path, node, s_context, global_context, old_cache, new_cache, all_posts, NULL, NULL, NULL, NULL);
+		enqueue_job(queue, all_posts, node, NULL, NULL, NULL, NULL);
 	}
 }
 
-void process_file(const char* vault_path, NavNode* current_node, SiteContext* s_context, TemplateContext* global_context, HashTable* old_cache, HashTable* new_cache, struct list_head* all_posts, NavNode* prev_node, NavNode* next_node, NavNode* first_node, const char* series_name) {
-	printf("Processing: %s\n", current_node->full_path);
+// Series navigation depends on the other posts of the category, so every
+// value set here is recorded as a dependency of the page.
+static void add_series_context(TemplateContext* t_context, const BuildJob* job, const char* base_url) {
+	if (job->series_name) {
+		add_to_context(t_context, "series", job->series_name);
+	}
+	record_value_dependency("series", job->series_name);
 
-	char full_input_path[MAX_PATH_LENGTH];
-	snprintf(full_input_path, sizeof(full_input_path), "%s/%s", vault_path, current_node->full_path);
+	NavNode* target_nodes[] = { job->prev_node, job->next_node, job->first_node };
+	const char* link_keys[] = { "prev_post_link", "next_post_link", "first_post_link" };
+	const char* title_keys[] = { "prev_post_title", "next_post_title", "first_post_title" };
 
-	PostSortInfo* post_info = malloc(sizeof(PostSortInfo));
-	post_info->node = current_node;
-	extract_sort_info(full_input_path, post_info);
-	list_add_tail(&post_info->list, all_posts);
+	for (int i = 0; i < 3; i++) {
+		if (target_nodes[i]) {
+			char link[MAX_PATH_LENGTH];
+			snprintf(link, sizeof(link), "%s/%s", base_url, target_nodes[i]->slug);
+			add_to_context(t_context, link_keys[i], link);
 
-	char* current_hash = generate_file_hash(full_input_path);
-	char* old_cache_value = old_cache ? (char*)ht_get(old_cache, full_input_path) : NULL;
+			char* title_no_ext = strdup(target_nodes[i]->name);
+			char* dot = strrchr(title_no_ext, '.');
+			if (dot) *dot = '\0';
+			add_to_context(t_context, title_keys[i], title_no_ext);
+			free(title_no_ext);
+		} else {
+			add_to_context(t_context, link_keys[i], "#");
+			add_to_context(t_context, title_keys[i], "해당하는 글이 없습니다.");
+		}
+		record_value_dependency(link_keys[i], (const char*)ht_get(t_context, link_keys[i]));
+		record_value_dependency(title_keys[i], (const char*)ht_get(t_context, title_keys[i]));
+	}
+}
 
-	if (old_cache_value) {
-		char* old_hash_only = strdup(old_cache_value);
-		char* delimiter = strrchr(old_hash_only, ':');
-		if (delimiter) *delimiter = '\0';
+// Stands in for the rendered backlinks in the page's dependencies, so an
+// unchanged page is checked without building them.
+static void backlinks_digest(const BuildEnv* env, const BuildJob* job, const char* base_url, unsigned char* digest) {
+	uint64_t hash = get_backlinks_digest(env->link_graph, job->node);
+	hash = fnv1a_update(hash, base_url, strlen(base_url));
+	memset(digest, 0, HASH_DIGEST_SIZE);
+	memcpy(digest, &hash, sizeof(hash));
+}
 
-		if (current_hash && strcmp(current_hash, old_hash_only) == 0) {
-			char* output_path_from_cache = strrchr(old_cache_value, ':');
-			if (output_path_from_cache) {
-				output_path_from_cache++;
-			}
+// The pages linking to this one, from the link graph. Recorded like the
+// series values, so a page is rebuilt exactly when its backlinks change.
+static void add_backlinks_context(TemplateContext* t_context, const BuildEnv* env, const BuildJob* job, const char* base_url) {
+	const LinkEdge* backlinks;
+	size_t count = get_backlinks(env->link_graph, job->node, &backlinks);
 
-			if (output_path_from_cache && check_path_type(output_path_from_cache) == 1) {
-				printf("Skipping (cached): %s\n", current_node->full_path);
-				ht_set(new_cache, strdup(full_input_path), strdup(old_cache_value));
-				free(old_hash_only);
-				free(current_hash);
-				return;
-			} else {
-				printf("Rebuilding (output missing): %s\n", current_node->full_path);
-			}
+	if (count == 0) {
+		add_to_context(t_context, "backlinks", "<span>이 글을 링크한 글이 없습니다.</span>");
+	} else {
+		DynamicBuffer* buffer = create_dynamic_buffer(256);
+		buffer_append_formatted(buffer, "<ul class=\"backlinks\">\n");
+		for (size_t i = 0; i < count; i++) {
+			const NavNode* source = backlinks[i].source->node;
+			char* title = strdup(source->meta.title ? source->meta.title : source->name);
+			char* dot = strrchr(title, '.');
+			if (!source->meta.title && dot) *dot = '\0';
+
+			buffer_append_formatted(buffer, "<li><a href=\"%s%s\">%s</a></li>\n", base_url, backlinks[i].source->url, title);
+			free(title);
 		}
-		free(old_hash_only);
+		buffer_append_formatted(buffer, "</ul>\n");
+
+		char* backlinks_html = destroy_buffer_and_get_content(buffer);
+		add_to_context(t_context, "backlinks", backlinks_html);
+		free(backlinks_html);
 	}
+	unsigned char digest[HASH_DIGEST_SIZE];
+	backlinks_digest(env, job, base_url, digest);
+	record_value_digest("backlinks", digest);
+}
 
-	printf("Building: %s\n", current_node->full_path);
+static void current_template_digest(const BuildEnv* env, const char* path, unsigned char* digest) {
+	pthread_mutex_lock(env->template_digests_lock);
+	unsigned char* memo = (unsigned char*)ht_get(env->template_digests, path);
+	if (!memo) {
+		memo = calloc(1, HASH_DIGEST_SIZE);
+		generate_file_digest(path, memo); // stays zero if the template is gone
+		ht_set(env->template_digests, path, memo);
+	}
+	memcpy(digest, memo, HASH_DIGEST_SIZE);
+	pthread_mutex_unlock(env->template_digests_lock);
+}
 
-	FILE* md_file = fopen(full_input_path, "r");
-	if (!md_file) {
-		perror("	[ERROR] Could not open makedown file");
-		return;
+// Returns the name of the first recorded dependency whose current value no
+// longer matches the previous build, or NULL if all of them are unchanged.
+static const char* find_changed_dependency(const BuildEnv* env, const BuildJob* job, const CacheRecord* record) {
+	const DependencyRecord* deps = cache_record_dependencies(env->old_cache, record);
+	TemplateContext* value_context = NULL;
+	const char* changed = NULL;
+	const char* base_url = (const char*)ht_get(env->global_context, "base_url");
+	if (!base_url) base_url = "";
+
+	for (uint32_t i = 0; i < record->dependency_count && !changed; i++) {
+		const char* name = cache_dependency_name(env->old_cache, &deps[i]);
+		unsigned char digest[HASH_DIGEST_SIZE];
+
+		switch (deps[i].kind) {
+			case DEP_TEMPLATE:
+				current_template_digest(env, name, digest);
+				break;
+			case DEP_CONFIG:
+				dependency_digest((const char*)ht_get(env->global_context, name), digest);
+				break;
+			case DEP_LINK:
+				resolve_link_digest(env->s_context, name, digest);
+				break;
+			case DEP_VALUE:
+				if (!job) {
+					changed = name;
+					continue;
+				}
+				if (strcmp(name, "backlinks") == 0) {
+					backlinks_digest(env, job, base_url, digest);
+					break;
+				}
+				if (!value_context) {
+					value_context = create_template_context();
+					add_series_context(value_context, job, base_url);
+				}
+				dependency_digest((const char*)ht_get(value_context, name), digest);
+				break;
+			default:
+				changed = name;
+				continue;
+		}
+
+		if (memcmp(digest, deps[i].digest, HASH_DIGEST_SIZE) != 0) {
+			changed = name;
+		}
 	}
 
-	TemplateContext* t_context = create_template_context();
-	copy_context(t_context, global_context);
+	if (value_context) free_template_context(value_context);
+	return changed;
+}
 
-	char* content_md = parse_front_matter(md_file, t_context);
-	fclose(md_file);
+static void copy_cached_dependencies(const BuildCache* cache, const CacheRecord* record, DependencyList* list) {
+	const DependencyRecord* deps = cache_record_dependencies(cache, record);
+	for (uint32_t i = 0; i < record->dependency_count; i++) {
+		dependency_list_add(list, (DependencyKind)deps[i].kind, cache_dependency_name(cache, &deps[i]), deps[i].digest);
+	}
+}
+
+// Returns the stamp to record for this build. A file modified during the
+// current second could change again without moving its mtime, so it is
+// stored without a stamp and gets hashed on the next build.
+static FileStamp stamp_for_cache(const BuildEnv* env, const FileStamp* current) {
+	FileStamp stamp = *current;
+	if (stamp.mtime_sec >= env->started_at || stamp.ctime_sec >= env->started_at) {
+		memset(&stamp, 0, sizeof(stamp));
+	}
+	return stamp;
+}
+
+// True when the note still has the content old_record was built from. The
+// note is read and hashed only when its stat stamp cannot tell and it has
+// not been hashed yet.
+static bool source_unchanged(const BuildEnv* env, NavNode* node, const char* full_input_path, const CacheRecord* old_record) {
+	FileStamp old_stamp;
+	cache_record_stamp(old_record, &old_stamp);
+	bool paranoid = env->options && env->options->paranoid;
+	if (!paranoid && file_stamp_equal(&old_stamp, &node->stamp)) return true;
+	if (!node->source && node->has_source_digest) {
+		return memcmp(node->source_digest, old_record->digest, HASH_DIGEST_SIZE) == 0;
+	}
+
+	SourceDocument* source = load_note_source(node, full_input_path);
+	return source && memcmp(get_source_digest(source), old_record->digest, HASH_DIGEST_SIZE) == 0;
+}
+
+// Parses the body, from the file when the note is too large to hold whole.
+// If that file can no longer be read, only the head is parsed and *complete
+// is cleared.
+static Ast* parse_note_body(SourceDocument* source, bool* complete) {
+	FILE* file = source->path ? fopen(source->path, "rb") : NULL;
+	if (file && fseek(file, source->body_offset, SEEK_SET) != 0) {
+		fclose(file);
+		file = NULL;
+	}
+	*complete = !source->path || file;
+	if (!*complete) perror(source->path);
+
+	TokenStream* tokens = file ? create_file_token_stream(file, SOURCE_STREAM_CHUNK) : create_token_stream(source->body);
+	Ast* ast = parse_document(tokens);
+	free_token_stream(tokens);
+	if (file) fclose(file);
+	return ast;
+}
+
+// unchanged markdown reuses the Ast an earlier build stored for it
+static Ast* load_note_ast(SourceDocument* source) {
+	const unsigned char* source_digest = get_source_digest(source);
+	Ast* ast = load_cached_ast(source_digest);
+	if (!ast) {
+		bool complete;
+		ast = parse_note_body(source, &complete);
+		if (complete) store_cached_ast(source_digest, ast);
+	}
+	return ast;
+}
 
-	if (!content_md) {
-		md_file = fopen(full_input_path, "r");
-		DynamicBuffer* db = create_dynamic_buffer(0);
-		char line[MAX_PATH_LENGTH];
-		while (fgets(line, sizeof(line), md_file)) {
-			buffer_append_formatted(db, "%s", line);
+// Keeps a freshly parsed Ast for rendering, so it is not read back from
+// the cache right after being written, while the kept ones fit the budget.
+static void keep_note_ast(const BuildEnv* env, BuildJob* job, Ast* ast) {
+	size_t size = ast->node_count * sizeof(AstNode) + ast->link_count * sizeof(AstNodeId) + ast->strings_capacity;
+	pthread_mutex_lock(env->kept_ast_lock);
+	bool fits = *env->kept_ast_bytes + size <= KEPT_AST_BUDGET;
+	if (fits) *env->kept_ast_bytes += size;
+	pthread_mutex_unlock(env->kept_ast_lock);
+
+	if (fits) {
+		job->ast = ast;
+	} else {
+		free_ast(ast);
+	}
+}
+
+// Heading ids as the page renders them, and block ids.
+static void collect_note_anchors(BuildJob* job, const Ast* ast) {
+	size_t capacity = 0;
+	for (size_t i = 0; i < ast->node_count; i++) {
+		const AstNode* node = &ast->nodes[i];
+		char* anchor_id = NULL;
+		switch (node->type) {
+			case NODE_HEADING1:
+			case NODE_HEADING2:
+			case NODE_HEADING3:
+				anchor_id = generate_anchor_id(ast_data1(ast, node));
+				break;
+			case NODE_PARAGRAPH:
+			case NODE_LIST_ITEM:
+			case NODE_BLOCKQUOTE:
+				if (ast_data1(ast, node)) anchor_id = strdup(ast_data1(ast, node));
+				break;
+			default:
+				break;
 		}
-		fclose(md_file);
-		content_md = destroy_buffer_and_get_content(db);
+		if (!anchor_id) continue;
+
+		if (job->anchor_count == capacity) {
+			capacity = capacity ? capacity * 2 : 16;
+			job->anchors = realloc(job->anchors, capacity * sizeof(char*));
+		}
+		job->anchors[job->anchor_count++] = anchor_id;
 	}
+}
 
-	const char* base_url = get_from_context(global_context, "base_url");
-	if (!base_url) base_url = "";
+static void add_page_link(const LinkResolver* resolver, BuildJob* job, const char* link_target) {
+	const LinkTarget* target = resolve_link_target(resolver, link_target);
+	if (!target) return;
+	job->links[job->link_count++] = target;
+	if (find_link_fragment(link_target)) job->anchored_links[job->anchored_link_count++] = target;
+}
 
-	if (series_name) {
-		add_to_context(t_context, "series", series_name);
+// The wikilink targets of a page. An unchanged note links what it linked
+// last time, so they come from its recorded link dependencies. Any other
+// note is parsed, which gives its anchors too. It will be rebuilt, so its
+// Ast stays on the job for process_file, within KEPT_AST_BUDGET.
+static void collect_page_links(const BuildEnv* env, BuildJob* job) {
+	const LinkResolver* resolver = env->s_context->link_resolver;
+	char full_input_path[MAX_PATH_LENGTH];
+	snprintf(full_input_path, sizeof(full_input_path), "%s/%s", env->vault_path, job->node->full_path);
+
+	const CacheRecord* old_record = cache_lookup(env->old_cache, full_input_path);
+	if (old_record && source_unchanged(env, job->node, full_input_path, old_record)) {
+		const DependencyRecord* deps = cache_record_dependencies(env->old_cache, old_record);
+		size_t capacity = old_record->dependency_count ? old_record->dependency_count : 1;
+		job->links = malloc(capacity * sizeof(LinkTarget*));
+		job->anchored_links = malloc(capacity * sizeof(LinkTarget*));
+		for (uint32_t i = 0; i < old_record->dependency_count; i++) {
+			if (deps[i].kind != DEP_LINK) continue;
+			add_page_link(resolver, job, cache_dependency_name(env->old_cache, &deps[i]));
+		}
+		// it was read at most to be hashed; a rebuild reads it again
+		release_note_source(job->node);
+		return;
 	}
 
-	NavNode* target_nodes[] = { prev_node, next_node, first_node };
-	const char* link_keys[] = { "prev_post_link", "next_post_link", "first_post_link" };
-	const char* title_keys[] = { "prev_post_title", "next_post_title", "first_post_title" };
+	SourceDocument* source = load_note_source(job->node, full_input_path);
+	if (!source) return;
 
-	for (int i = 0; i < 3; i++) {
-		if (target_nodes[i]) {
-			char link[MAX_PATH_LENGTH];
-			snprintf(link, sizeof(link), "%s/%s", base_url, target_nodes[i]->slug);
-			add_to_context(t_context, link_keys[i], link);
+	Ast* ast = load_note_ast(source);
+	size_t capacity = ast->link_count ? ast->link_count : 1;
+	job->links = malloc(capacity * sizeof(LinkTarget*));
+	job->anchored_links = malloc(capacity * sizeof(LinkTarget*));
+	for (size_t i = 0; i < ast->link_count; i++) {
+		add_page_link(resolver, job, ast_data1(ast, &ast->nodes[ast->links[i]]));
+	}
+	collect_note_anchors(job, ast);
+	job->anchors_collected = true;
+	keep_note_ast(env, job, ast);
+}
 
-			char* title_no_ext = strdup(target_nodes[i]->name);
-			char* dot = strrchr(title_no_ext, '.');
-			if (dot) *dot = '\0';
-			add_to_context(t_context, title_keys[i], title_no_ext);
-			free(title_no_ext);
-		} else {
-			add_to_context(t_context, link_keys[i], "#");
-			add_to_context(t_context, title_keys[i], "해당하는 글이 없습니다.");
+// Only notes some page links into with a fragment need their anchors.
+static void mark_anchored_notes(const LinkResolver* resolver, BuildQueue* queue) {
+	bool* anchored = calloc(resolver->target_count ? resolver->target_count : 1, sizeof(bool));
+	for (size_t i = 0; i < queue->count; i++) {
+		for (size_t j = 0; j < queue->jobs[i].anchored_link_count; j++) {
+			anchored[queue->jobs[i].anchored_links[j] - resolver->targets] = true;
+		}
+	}
+	for (size_t i = 0; i < queue->count; i++) {
+		BuildJob* job = &queue->jobs[i];
+		const LinkTarget* target = link_target_of_node(resolver, job->node);
+		job->anchors_needed = target && anchored[target - resolver->targets] && !job->anchors_collected;
+	}
+	free(anchored);
+}
+
+// The anchors of an unchanged note that is linked into, from the Ast stored
+// for its recorded digest; the note is read and parsed only if that is gone.
+static void collect_page_anchors(const BuildEnv* env, BuildJob* job) {
+	if (!job->anchors_needed) return;
+	char full_input_path[MAX_PATH_LENGTH];
+	snprintf(full_input_path, sizeof(full_input_path), "%s/%s", env->vault_path, job->node->full_path);
+
+	const CacheRecord* old_record = cache_lookup(env->old_cache, full_input_path);
+	Ast* ast = old_record ? load_cached_ast(old_record->digest) : NULL;
+	if (!ast) {
+		SourceDocument* source = load_note_source(job->node, full_input_path);
+		if (!source) return;
+		ast = load_note_ast(source);
+	}
+	collect_note_anchors(job, ast);
+	job->anchors_collected = true;
+	free_ast(ast);
+	release_note_source(job->node);
+}
+
+static void process_file(const BuildEnv* env, BuildJob* job) {
+	NavNode* current_node = job->node;
+	SiteContext* s_context = env->s_context;
+	TemplateContext* global_context = env->global_context;
+	printf("Processing: %s\n", current_node->full_path);
+
+	char full_input_path[MAX_PATH_LENGTH];
+	snprintf(full_input_path, sizeof(full_input_path), "%s/%s", env->vault_path, current_node->full_path);
+
+	// notes whose metadata came from the cache are only read when they have to be
+	const CacheRecord* old_record = cache_lookup(env->old_cache, full_input_path);
+	FileStamp current_stamp = stamp_for_cache(env, &current_node->stamp);
+
+	if (old_record) {
+		if (source_unchanged(env, current_node, full_input_path, old_record)) {
+			const char* old_output_path = cache_record_output_path(env->old_cache, old_record);
+			const char* changed_dependency = NULL;
+			if (check_path_type(old_output_path) != 1) {
+				printf("Rebuilding (output missing): %s\n", current_node->full_path);
+			} else if ((changed_dependency = find_changed_dependency(env, job, old_record)) != NULL) {
+				printf("Rebuilding (dependency changed: %s): %s\n", changed_dependency, current_node->full_path);
+			} else {
+				printf("Skipping (cached): %s\n", current_node->full_path);
+				job->cache_key = strdup(full_input_path);
+				job->cache_entry = create_cache_entry(old_record->digest, old_output_path, &current_stamp);
+				memcpy(job->cache_entry->output_digest, old_record->output_digest, HASH_DIGEST_SIZE);
+				copy_cached_dependencies(env->old_cache, old_record, &job->cache_entry->dependencies);
+				copy_note_metadata(&job->cache_entry->metadata, &current_node->meta);
+				release_note_source(current_node);
+				free_ast(job->ast);
+				job->ast = NULL;
+				return;
+			}
 		}
 	}
 
-	LIST_HEAD(token_list);
-	tokenize_string(content_md, &token_list);
-	AstNode* ast_root = parse_tokens(&token_list, s_context, current_node->full_path);
+	SourceDocument* source = load_note_source(current_node, full_input_path);
+	if (!source) {
+		fprintf(stderr, "	[ERROR] Could not read markdown file: %s\n", full_input_path);
+		return;
+	}
+
+	printf("Building: %s\n", current_node->full_path);
+
+	DependencyList dependencies;
+	dependency_list_init(&dependencies);
+	start_dependency_recording(&dependencies, global_context);
+
+	TemplateContext* t_context = create_template_context();
+	copy_context(t_context, global_context);
+	copy_context(t_context, source->front_matter);
 
-	char* content_html_partial = generate_html_from_ast(ast_root, t_context);
+	const char* base_url = get_from_context(global_context, "base_url");
+	if (!base_url) base_url = "";
+
+	add_series_context(t_context, job, base_url);
+	add_backlinks_context(t_context, env, job, base_url);
+
+	Ast* ast = job->ast ? job->ast : load_note_ast(source);
+	job->ast = NULL;
+	resolve_wikilinks(ast, s_context);
+
+	char* content_html_partial = generate_html_from_ast(ast, t_context);
 	add_to_context(t_context, "post_content", content_html_partial);
 
-	char* toc_html = generate_toc_from_ast(ast_root);
+	char* toc_html = generate_toc_from_ast(ast);
 	if (toc_html && strlen(toc_html) > 0) {
 		add_to_context(t_context, "table_of_contents", toc_html);
 	} else {
@@ -382,6 +907,7 @@ void process_file(const char* vault_path, NavNode* current_node, SiteContext* s_
 	add_to_context(t_context, "content", content_html_full);
 
 	char* final_html = render_template("templates/layout/base.html", t_context);
+	stop_dependency_recording();
 
 	if (final_html) {
 		const char* output_dir = get_from_context(global_context, "build.output_dir");
@@ -392,30 +918,37 @@ void process_file(const char* vault_path, NavNode* current_node, SiteContext* s_
 
 		create_parent_directories(full_output_path);
 
-		FILE* out_file = fopen(full_output_path, "w");
-		if (out_file) {
-			fprintf(out_file, "%s", final_html);
-			fclose(out_file);
+		unsigned char output_digest[HASH_DIGEST_SIZE];
+		const unsigned char* previous_digest = cache_previous_output_digest(env->old_cache, full_input_path, full_output_path);
+		OutputStatus status = write_output_file(full_output_path, final_html, strlen(final_html), previous_digest, output_digest);
+		if (status == OUTPUT_UNCHANGED) {
+			printf("[SUCCESS] Unchanged, not rewritten: %s\n", full_output_path);
+		} else if (status != OUTPUT_FAILED) {
 			printf("[SUCCESS] Created: %s\n", full_output_path);
 		} else {
 			fprintf(stderr, "	[ERROR] Failed to write to: %s\n", full_output_path);
 		}
 
-		if (current_hash) {
-			DynamicBuffer* db = create_dynamic_buffer(0);
-			buffer_append_formatted(db, "%s:%s", current_hash, full_output_path);
-			char* cache_value_str = destroy_buffer_and_get_content(db);
-			ht_set(new_cache, strdup(full_input_path), cache_value_str);
+		job->cache_key = strdup(full_input_path);
+		job->cache_entry = create_cache_entry(get_source_digest(source), full_output_path, &current_stamp);
+		if (status != OUTPUT_FAILED) {
+			memcpy(job->cache_entry->output_digest, output_digest, HASH_DIGEST_SIZE);
 		}
+		job->cache_entry->dependencies = dependencies;
+		dependency_list_init(&dependencies);
+		copy_note_metadata(&job->cache_entry->metadata, &current_node->meta);
+
+		// lets an interrupted build resume from here
+		append_cache_journal(job->cache_key, job->cache_entry);
 	}
 
-	free(content_md);
 	free(content_html_partial);
 	free(content_html_full);
 	free(final_html);
-	free_ast(ast_root);
+	free_ast(ast);
 	free_template_context(t_context);
-	if (current_hash) free(current_hash);
+	dependency_list_free(&dependencies);
+	release_note_source(current_node);
 }
 
 
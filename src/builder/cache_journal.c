@@ -0,0 +1,284 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "../include/cache_manager.h"
+#include "../include/dynamic_buffer.h"
+
+/*
+ * Append-only log of the cache entries finished by the running build. A
+ * build that completes replaces it with a full cache file; one that is
+ * killed leaves it behind, and load_cache() folds it into the cache.
+ *
+ * The file starts with a JournalHeader. A journal written with another
+ * CACHE_FORMAT_VERSION is not replayed. Then one frame per entry:
+ *   uint32_t payload_length
+ *   uint8_t digest[HASH_DIGEST_SIZE]   SHA-256 of the payload
+ *   payload:
+ *     string key, string output_path
+ *     digest, output_digest, JournalStamp
+ *     string slug, excerpt, title, date, aliases
+ *     int32_t id, order, has_order
+ *     uint32_t dependency_count, then per dependency: uint32_t kind, string name, digest
+ *
+ * Strings are a uint8_t presence flag followed by uint32_t length and bytes.
+ * A torn frame at the end (crash during the write) ends the replay.
+ */
+typedef struct {
+	char magic[8];
+	uint32_t version;
+	uint32_t reserved;
+} JournalHeader;
+
+typedef struct {
+	int64_t mtime_sec;
+	int64_t mtime_nsec;
+	int64_t ctime_sec;
+	int64_t ctime_nsec;
+	int64_t size;
+	uint64_t inode;
+} JournalStamp;
+
+static struct {
+	FILE* file;
+	pthread_mutex_t lock;
+} journal = { NULL, PTHREAD_MUTEX_INITIALIZER };
+
+static void get_journal_path(char* buffer, size_t size) {
+	snprintf(buffer, size, "%s/%s", CACHE_DIR, CACHE_JOURNAL_FILE);
+}
+
+static void put_string(DynamicBuffer* buffer, const char* str) {
+	uint8_t present = str != NULL;
+	buffer_append_bytes(buffer, &present, sizeof(present));
+	if (!str) return;
+
+	uint32_t length = (uint32_t)strlen(str);
+	buffer_append_bytes(buffer, &length, sizeof(length));
+	buffer_append_bytes(buffer, str, length);
+}
+
+static void put_int32(DynamicBuffer* buffer, int32_t value) {
+	buffer_append_bytes(buffer, &value, sizeof(value));
+}
+
+static void serialize_entry(DynamicBuffer* payload, const char* key, const CacheEntry* entry) {
+	JournalStamp stamp = {
+		.mtime_sec = entry->stamp.mtime_sec,
+		.mtime_nsec = entry->stamp.mtime_nsec,
+		.ctime_sec = entry->stamp.ctime_sec,
+		.ctime_nsec = entry->stamp.ctime_nsec,
+		.size = entry->stamp.size,
+		.inode = entry->stamp.inode,
+	};
+
+	put_string(payload, key);
+	put_string(payload, entry->output_path);
+	buffer_append_bytes(payload, entry->digest, HASH_DIGEST_SIZE);
+	buffer_append_bytes(payload, entry->output_digest, HASH_DIGEST_SIZE);
+	buffer_append_bytes(payload, &stamp, sizeof(stamp));
+
+	put_string(payload, entry->metadata.slug);
+	put_string(payload, entry->metadata.excerpt);
+	put_string(payload, entry->metadata.title);
+	put_string(payload, entry->metadata.date);
+	put_string(payload, entry->metadata.aliases);
+	put_int32(payload, entry->metadata.id);
+	put_int32(payload, entry->metadata.order);
+	put_int32(payload, entry->metadata.has_order);
+
+	put_int32(payload, (int32_t)entry->dependencies.count);
+	for (size_t i = 0; i < entry->dependencies.count; i++) {
+		const Dependency* dep = &entry->dependencies.items[i];
+		put_int32(payload, (int32_t)dep->kind);
+		put_string(payload, dep->name);
+		buffer_append_bytes(payload, dep->digest, HASH_DIGEST_SIZE);
+	}
+}
+
+// Thread-safe. Flushed per entry, so the entry survives the process being killed.
+void append_cache_journal(const char* key, const CacheEntry* entry) {
+	DynamicBuffer* payload = create_dynamic_buffer(512);
+	serialize_entry(payload, key, entry);
+
+	uint32_t length = (uint32_t)payload->length;
+	unsigned char digest[HASH_DIGEST_SIZE];
+	generate_buffer_digest(payload->content, payload->length, digest);
+
+	pthread_mutex_lock(&journal.lock);
+	if (!journal.file) {
+		char path[256];
+		get_journal_path(path, sizeof(path));
+		journal.file = fopen(path, "ab");
+		if (!journal.file) {
+			fprintf(stderr, "Warning: Could not open cache journal '%s'.\n", path);
+		} else if (fseek(journal.file, 0, SEEK_END) == 0 && ftell(journal.file) == 0) {
+			JournalHeader header = { .version = CACHE_FORMAT_VERSION };
+			memcpy(header.magic, CACHE_JOURNAL_MAGIC, sizeof(header.magic));
+			fwrite(&header, sizeof(header), 1, journal.file);
+		}
+	}
+	if (journal.file) {
+		fwrite(&length, sizeof(length), 1, journal.file);
+		fwrite(digest, 1, HASH_DIGEST_SIZE, journal.file);
+		fwrite(payload->content, 1, payload->length, journal.file);
+		fflush(journal.file);
+	}
+	pthread_mutex_unlock(&journal.lock);
+
+	free(destroy_buffer_and_get_content(payload));
+}
+
+void close_cache_journal() {
+	pthread_mutex_lock(&journal.lock);
+	if (journal.file) {
+		fclose(journal.file);
+		journal.file = NULL;
+	}
+	pthread_mutex_unlock(&journal.lock);
+}
+
+void remove_cache_journal() {
+	close_cache_journal();
+
+	char path[256];
+	get_journal_path(path, sizeof(path));
+	remove(path);
+}
+
+typedef struct {
+	const char* cursor;
+	const char* end;
+} JournalReader;
+
+static bool get_bytes(JournalReader* reader, void* out, size_t length) {
+	if ((size_t)(reader->end - reader->cursor) < length) return false;
+	memcpy(out, reader->cursor, length);
+	reader->cursor += length;
+	return true;
+}
+
+static bool get_int32(JournalReader* reader, int32_t* value) {
+	return get_bytes(reader, value, sizeof(*value));
+}
+
+static bool get_string(JournalReader* reader, char** out) {
+	uint8_t present;
+	uint32_t length;
+	*out = NULL;
+	if (!get_bytes(reader, &present, sizeof(present))) return false;
+	if (!present) return true;
+	if (!get_bytes(reader, &length, sizeof(length))) return false;
+	if ((size_t)(reader->end - reader->cursor) < length) return false;
+
+	*out = strndup(reader->cursor, length);
+	reader->cursor += length;
+	return true;
+}
+
+static bool parse_entry(JournalReader* reader, char** key, CacheEntry** entry_out) {
+	char* output_path = NULL;
+	unsigned char digest[HASH_DIGEST_SIZE];
+	JournalStamp raw;
+	*entry_out = NULL;
+
+	if (!get_string(reader, key) || !*key) return false;
+	if (!get_string(reader, &output_path) || !output_path) return false;
+	if (!get_bytes(reader, digest, HASH_DIGEST_SIZE)) {
+		free(output_path);
+		return false;
+	}
+
+	FileStamp stamp = { 0 };
+	CacheEntry* entry = create_cache_entry(digest, output_path, &stamp);
+	*entry_out = entry;
+	free(output_path);
+	if (!get_bytes(reader, entry->output_digest, HASH_DIGEST_SIZE) || !get_bytes(reader, &raw, sizeof(raw))) return false;
+	entry->stamp.mtime_sec = raw.mtime_sec;
+	entry->stamp.mtime_nsec = raw.mtime_nsec;
+	entry->stamp.ctime_sec = raw.ctime_sec;
+	entry->stamp.ctime_nsec = raw.ctime_nsec;
+	entry->stamp.size = raw.size;
+	entry->stamp.inode = raw.inode;
+
+	int32_t id, order, has_order, dependency_count;
+	if (!get_string(reader, &entry->metadata.slug) || !get_string(reader, &entry->metadata.excerpt)
+			|| !get_string(reader, &entry->metadata.title) || !get_string(reader, &entry->metadata.date)
+			|| !get_string(reader, &entry->metadata.aliases)
+			|| !get_int32(reader, &id) || !get_int32(reader, &order) || !get_int32(reader, &has_order)
+			|| !get_int32(reader, &dependency_count) || dependency_count < 0) {
+		return false;
+	}
+	entry->metadata.id = id;
+	entry->metadata.order = order;
+	entry->metadata.has_order = has_order != 0;
+
+	for (int32_t i = 0; i < dependency_count; i++) {
+		int32_t kind;
+		char* name;
+		unsigned char dep_digest[HASH_DIGEST_SIZE];
+		if (!get_int32(reader, &kind) || !get_string(reader, &name) || !name) return false;
+		if (!get_bytes(reader, dep_digest, HASH_DIGEST_SIZE)) {
+			free(name);
+			return false;
+		}
+		dependency_list_add(&entry->dependencies, (DependencyKind)kind, name, dep_digest);
+		free(name);
+	}
+	return reader->cursor == reader->end;
+}
+
+// Adds every complete journal frame to entries (key -> CacheEntry*), later
+// frames replacing earlier ones. Returns the number of frames applied.
+size_t replay_cache_journal(HashTable* entries) {
+	char path[256];
+	get_journal_path(path, sizeof(path));
+
+	FILE* file = fopen(path, "rb");
+	if (!file) return 0;
+
+	JournalHeader header;
+	if (fread(&header, sizeof(header), 1, file) != 1
+			|| memcmp(header.magic, CACHE_JOURNAL_MAGIC, sizeof(header.magic)) != 0
+			|| header.version != CACHE_FORMAT_VERSION) {
+		fprintf(stderr, "Warning: Cache journal '%s' is from another version. Discarding it.\n", path);
+		fclose(file);
+		remove(path);
+		return 0;
+	}
+
+	size_t applied = 0;
+	uint32_t length;
+	unsigned char digest[HASH_DIGEST_SIZE];
+	while (fread(&length, sizeof(length), 1, file) == 1 && fread(digest, 1, HASH_DIGEST_SIZE, file) == HASH_DIGEST_SIZE) {
+		char* payload = malloc(length ? length : 1);
+		if (!payload || fread(payload, 1, length, file) != length) {
+			free(payload);
+			break;
+		}
+
+		unsigned char actual[HASH_DIGEST_SIZE];
+		generate_buffer_digest(payload, length, actual);
+		if (memcmp(actual, digest, HASH_DIGEST_SIZE) != 0) {
+			free(payload);
+			break;
+		}
+
+		JournalReader reader = { payload, payload + length };
+		char* key = NULL;
+		CacheEntry* entry = NULL;
+		if (parse_entry(&reader, &key, &entry)) {
+			free_cache_entry(ht_get(entries, key));
+			ht_set(entries, key, entry);
+			applied++;
+		} else {
+			free_cache_entry(entry);
+		}
+		free(key);
+		free(payload);
+	}
+	fclose(file);
+	return applied;
+}
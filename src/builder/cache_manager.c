@@ -1,12 +1,17 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdbool.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "../include/cache_manager.h"
 #include "../include/file_utils.h"
+#include "../include/dynamic_buffer.h"
 
-#define INITIAL_CACHE_SIZE 1024
+#define MIN_CACHE_SLOTS 16
 
 int ensure_cache_dir_exists() {
 	int path_type = check_path_type(CACHE_DIR);
@@ -34,62 +39,385 @@ int ensure_cache_dir_exists() {
 	return 0;
 }
 
-HashTable* load_cache() {
-	HashTable* cache = ht_create(INITIAL_CACHE_SIZE);
+CacheEntry* create_cache_entry(const unsigned char* digest, const char* output_path, const FileStamp* stamp) {
+	CacheEntry* entry = calloc(1, sizeof(CacheEntry));
+	memcpy(entry->digest, digest, HASH_DIGEST_SIZE);
+	entry->output_path = strdup(output_path);
+	if (stamp) {
+		entry->stamp = *stamp;
+	} else {
+		memset(&entry->stamp, 0, sizeof(FileStamp));
+	}
+	dependency_list_init(&entry->dependencies);
+	return entry;
+}
+
+void free_cache_entry(void* entry) {
+	CacheEntry* cache_entry = (CacheEntry*)entry;
+	if (!cache_entry) return;
+	free(cache_entry->output_path);
+	dependency_list_free(&cache_entry->dependencies);
+	free_note_metadata(&cache_entry->metadata);
+	free(cache_entry);
+}
+
+static void get_cache_path(char* buffer, size_t size, const char* suffix) {
+	snprintf(buffer, size, "%s/%s%s", CACHE_DIR, CACHE_FILE, suffix);
+}
+
+static bool valid_optional_offset(uint32_t offset, uint64_t strings_size) {
+	return offset == CACHE_NO_STRING || offset < strings_size;
+}
+
+static bool validate_cache_map(BuildCache* cache) {
+	if (cache->map_size < sizeof(CacheFileHeader)) return false;
+
+	const CacheFileHeader* header = (const CacheFileHeader*)cache->map;
+	if (memcmp(header->magic, CACHE_MAGIC, sizeof(header->magic)) != 0) return false;
+	if (header->version != CACHE_FORMAT_VERSION) return false;
+	if (header->record_size != sizeof(CacheRecord)) return false;
+	if (header->slot_count == 0 || (header->slot_count & (header->slot_count - 1)) != 0) return false;
+	if (header->record_count >= header->slot_count) return false;
+
+	size_t slots_size = (size_t)header->slot_count * sizeof(uint32_t);
+	size_t records_size = (size_t)header->record_count * sizeof(CacheRecord);
+	size_t dependencies_size = (size_t)header->dependency_count * sizeof(DependencyRecord);
+	size_t expected_size = sizeof(CacheFileHeader) + slots_size + records_size + dependencies_size + header->strings_size;
+	if (cache->map_size != expected_size) return false;
+
+	const char* body = (const char*)cache->map + sizeof(CacheFileHeader);
+	if (fnv1a(body, cache->map_size - sizeof(CacheFileHeader)) != header->checksum) return false;
+
+	cache->header = header;
+	cache->slots = (const uint32_t*)body;
+	cache->records = (const CacheRecord*)(body + slots_size);
+	cache->dependencies = (const DependencyRecord*)(body + slots_size + records_size);
+	cache->strings = body + slots_size + records_size + dependencies_size;
+	cache->record_count = header->record_count;
+
+	if (header->strings_size == 0 || cache->strings[header->strings_size - 1] != '\0') return false;
+	for (size_t i = 0; i < cache->record_count; i++) {
+		if (cache->records[i].key_offset >= header->strings_size) return false;
+		if (cache->records[i].output_offset >= header->strings_size) return false;
+		if ((uint64_t)cache->records[i].dependency_index + cache->records[i].dependency_count > header->dependency_count) return false;
+		if (!valid_optional_offset(cache->records[i].slug_offset, header->strings_size)) return false;
+		if (!valid_optional_offset(cache->records[i].excerpt_offset, header->strings_size)) return false;
+		if (!valid_optional_offset(cache->records[i].title_offset, header->strings_size)) return false;
+		if (!valid_optional_offset(cache->records[i].date_offset, header->strings_size)) return false;
+		if (!valid_optional_offset(cache->records[i].aliases_offset, header->strings_size)) return false;
+	}
+	for (size_t i = 0; i < header->dependency_count; i++) {
+		if (cache->dependencies[i].name_offset >= header->strings_size) return false;
+	}
+	return true;
+}
+
+static BuildCache* map_cache_file() {
+	BuildCache* cache = calloc(1, sizeof(BuildCache));
 	if (!cache) {
 		return NULL;
 	}
 
 	char cache_path[256];
-	snprintf(cache_path, sizeof(cache_path), "%s/%s", CACHE_DIR, CACHE_FILE);
+	get_cache_path(cache_path, sizeof(cache_path), "");
 
-	char* content = read_file_into_string(cache_path);
-	if (!content) {
+	int fd = open(cache_path, O_RDONLY);
+	if (fd < 0) {
 		return cache;
 	}
 
-	char* content_copy = strdup(content);
-	char* line = strtok(content_copy, "\n");
-	while (line != NULL) {
-		char* delimiter = strrchr(line, '\t');
-		if (delimiter) {
-			*delimiter = '\0';
-			char* key = line;
-			char* value = delimiter + 1;
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0) {
+		close(fd);
+		return cache;
+	}
 
-			char* key_copy = strdup(key);
-			char* value_copy = strdup(value);
-			ht_set(cache, key_copy, value_copy);
-		}
-		line = strtok(NULL, "\n");
+	void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		fprintf(stderr, "Warning: Could not map cache file '%s'. Rebuilding everything.\n", cache_path);
+		return cache;
 	}
 
-	free(content_copy);
-	free(content);
+	cache->map = map;
+	cache->map_size = st.st_size;
+	if (!validate_cache_map(cache)) {
+		fprintf(stderr, "Warning: Cache file '%s' is outdated or corrupted. Rebuilding everything.\n", cache_path);
+		munmap(map, st.st_size);
+		memset(cache, 0, sizeof(BuildCache));
+	}
 	return cache;
 }
 
+static CacheEntry* entry_from_record(const BuildCache* cache, const CacheRecord* record) {
+	FileStamp stamp;
+	cache_record_stamp(record, &stamp);
+
+	CacheEntry* entry = create_cache_entry(record->digest, cache_record_output_path(cache, record), &stamp);
+	memcpy(entry->output_digest, record->output_digest, HASH_DIGEST_SIZE);
+	cache_record_metadata(cache, record, &entry->metadata);
+
+	const DependencyRecord* deps = cache_record_dependencies(cache, record);
+	for (uint32_t i = 0; i < record->dependency_count; i++) {
+		dependency_list_add(&entry->dependencies, (DependencyKind)deps[i].kind, cache_dependency_name(cache, &deps[i]), deps[i].digest);
+	}
+	return entry;
+}
+
+// A journal left behind by an interrupted build is merged into the cache
+// file (compaction) before it is mapped for this build.
+BuildCache* load_cache() {
+	BuildCache* cache = map_cache_file();
+
+	char journal_path[256];
+	snprintf(journal_path, sizeof(journal_path), "%s/%s", CACHE_DIR, CACHE_JOURNAL_FILE);
+	if (!cache || check_path_type(journal_path) != 1) {
+		return cache;
+	}
+
+	HashTable* entries = ht_create(1024);
+	for (size_t i = 0; i < cache->record_count; i++) {
+		const CacheRecord* record = &cache->records[i];
+		ht_set(entries, cache_record_key(cache, record), entry_from_record(cache, record));
+	}
+	size_t replayed = replay_cache_journal(entries);
+	printf("Replayed %zu entries from the journal of an interrupted build.\n", replayed);
+
+	unload_cache(cache);
+	save_cache(entries); // also removes the journal
+	ht_destroy(entries, free_cache_entry);
+	return map_cache_file();
+}
+
+void unload_cache(BuildCache* cache) {
+	if (!cache) return;
+	if (cache->map) {
+		munmap(cache->map, cache->map_size);
+	}
+	free(cache);
+}
+
+const CacheRecord* cache_lookup(const BuildCache* cache, const char* key) {
+	if (!cache || cache->record_count == 0) return NULL;
+
+	uint64_t key_hash = fnv1a(key, strlen(key));
+	uint32_t mask = cache->header->slot_count - 1;
+
+	for (uint32_t slot = key_hash & mask;; slot = (slot + 1) & mask) {
+		uint32_t index = cache->slots[slot];
+		if (index == 0 || index > cache->record_count) return NULL;
+
+		const CacheRecord* record = &cache->records[index - 1];
+		if (record->key_hash == key_hash && strcmp(cache_record_key(cache, record), key) == 0) {
+			return record;
+		}
+	}
+}
+
+const CacheRecord* cache_record_at(const BuildCache* cache, size_t index) {
+	if (!cache || index >= cache->record_count) return NULL;
+	return &cache->records[index];
+}
+
+const char* cache_record_key(const BuildCache* cache, const CacheRecord* record) {
+	return cache->strings + record->key_offset;
+}
+
+const char* cache_record_output_path(const BuildCache* cache, const CacheRecord* record) {
+	return cache->strings + record->output_offset;
+}
+
+// digest of what the previous build wrote for key, NULL if it wrote elsewhere or nothing
+const unsigned char* cache_previous_output_digest(const BuildCache* cache, const char* key, const char* output_path) {
+	const CacheRecord* record = cache_lookup(cache, key);
+	if (!record || strcmp(cache_record_output_path(cache, record), output_path) != 0) return NULL;
+	return record->output_digest;
+}
+
+void cache_record_stamp(const CacheRecord* record, FileStamp* stamp) {
+	stamp->mtime_sec = record->mtime_sec;
+	stamp->mtime_nsec = record->mtime_nsec;
+	stamp->ctime_sec = record->ctime_sec;
+	stamp->ctime_nsec = record->ctime_nsec;
+	stamp->size = record->size;
+	stamp->inode = record->inode;
+}
+
+static char* copy_optional_string(const BuildCache* cache, uint32_t offset) {
+	return offset == CACHE_NO_STRING ? NULL : strdup(cache->strings + offset);
+}
+
+// fills metadata with copies owned by the caller
+void cache_record_metadata(const BuildCache* cache, const CacheRecord* record, NoteMetadata* metadata) {
+	metadata->slug = copy_optional_string(cache, record->slug_offset);
+	metadata->excerpt = copy_optional_string(cache, record->excerpt_offset);
+	metadata->title = copy_optional_string(cache, record->title_offset);
+	metadata->date = copy_optional_string(cache, record->date_offset);
+	metadata->aliases = copy_optional_string(cache, record->aliases_offset);
+	metadata->id = record->id;
+	metadata->order = record->order;
+	metadata->has_order = record->has_order != 0;
+}
+
+const DependencyRecord* cache_record_dependencies(const BuildCache* cache, const CacheRecord* record) {
+	return &cache->dependencies[record->dependency_index];
+}
+
+const char* cache_dependency_name(const BuildCache* cache, const DependencyRecord* dependency) {
+	return cache->strings + dependency->name_offset;
+}
+
+static int compare_entries_by_key(const void* a, const void* b) {
+	const HashEntry* entry_a = *(const HashEntry* const*)a;
+	const HashEntry* entry_b = *(const HashEntry* const*)b;
+	return strcmp(entry_a->key, entry_b->key);
+}
+
+// appends str and its NUL to the string pool, returns its offset
+static uint32_t append_string(DynamicBuffer* strings, const char* str) {
+	if (!str) return CACHE_NO_STRING;
+
+	uint32_t offset = (uint32_t)strings->length;
+	buffer_append_formatted(strings, "%s", str);
+	strings->length++; // keep the terminating NUL in the pool
+	return offset;
+}
+
+static bool write_all(FILE* file, const void* data, size_t size) {
+	return size == 0 || fwrite(data, 1, size, file) == size;
+}
+
 void save_cache(const HashTable* cache) {
 	if (!cache) {
 		return;
 	}
 
+	size_t record_count = 0;
+	for (size_t i = 0; i < cache->size; ++i) {
+		for (HashEntry* entry = cache->entries[i]; entry; entry = entry->next) {
+			record_count++;
+		}
+	}
+
+	// sorted so the file is byte-identical for the same set of entries
+	HashEntry** sorted = malloc((record_count ? record_count : 1) * sizeof(HashEntry*));
+	size_t n = 0;
+	for (size_t i = 0; i < cache->size; ++i) {
+		for (HashEntry* entry = cache->entries[i]; entry; entry = entry->next) {
+			sorted[n++] = entry;
+		}
+	}
+	qsort(sorted, record_count, sizeof(HashEntry*), compare_entries_by_key);
+
+	size_t dependency_count = 0;
+	for (size_t i = 0; i < record_count; i++) {
+		dependency_count += ((const CacheEntry*)sorted[i]->value)->dependencies.count;
+	}
+
+	uint32_t slot_count = MIN_CACHE_SLOTS;
+	while (slot_count < record_count * 2) {
+		slot_count *= 2;
+	}
+
+	uint32_t* slots = calloc(slot_count, sizeof(uint32_t));
+	CacheRecord* records = calloc(record_count ? record_count : 1, sizeof(CacheRecord));
+	DependencyRecord* dependencies = calloc(dependency_count ? dependency_count : 1, sizeof(DependencyRecord));
+	DynamicBuffer* strings = create_dynamic_buffer(4096);
+	size_t next_dependency = 0;
+
+	for (size_t i = 0; i < record_count; i++) {
+		const CacheEntry* value = (const CacheEntry*)sorted[i]->value;
+		CacheRecord* record = &records[i];
+
+		record->key_hash = fnv1a(sorted[i]->key, strlen(sorted[i]->key));
+		record->key_offset = append_string(strings, sorted[i]->key);
+		record->output_offset = append_string(strings, value->output_path);
+
+		record->slug_offset = append_string(strings, value->metadata.slug);
+		record->excerpt_offset = append_string(strings, value->metadata.excerpt);
+		record->title_offset = append_string(strings, value->metadata.title);
+		record->date_offset = append_string(strings, value->metadata.date);
+		record->aliases_offset = append_string(strings, value->metadata.aliases);
+		record->id = value->metadata.id;
+		record->order = value->metadata.order;
+		record->has_order = value->metadata.has_order;
+
+		record->mtime_sec = value->stamp.mtime_sec;
+		record->mtime_nsec = value->stamp.mtime_nsec;
+		record->ctime_sec = value->stamp.ctime_sec;
+		record->ctime_nsec = value->stamp.ctime_nsec;
+		record->size = value->stamp.size;
+		record->inode = value->stamp.inode;
+		memcpy(record->digest, value->digest, HASH_DIGEST_SIZE);
+		memcpy(record->output_digest, value->output_digest, HASH_DIGEST_SIZE);
+
+		record->dependency_index = (uint32_t)next_dependency;
+		record->dependency_count = (uint32_t)value->dependencies.count;
+		for (size_t j = 0; j < value->dependencies.count; j++) {
+			const Dependency* dep = &value->dependencies.items[j];
+			DependencyRecord* dep_record = &dependencies[next_dependency++];
+			dep_record->kind = dep->kind;
+			dep_record->name_offset = append_string(strings, dep->name);
+			memcpy(dep_record->digest, dep->digest, HASH_DIGEST_SIZE);
+		}
+
+		uint32_t slot = record->key_hash & (slot_count - 1);
+		while (slots[slot] != 0) {
+			slot = (slot + 1) & (slot_count - 1);
+		}
+		slots[slot] = (uint32_t)(i + 1);
+	}
+	if (strings->length == 0) {
+		strings->length = 1; // empty pool still ends with a NUL
+	}
+
+	CacheFileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+	header.version = CACHE_FORMAT_VERSION;
+	header.record_size = sizeof(CacheRecord);
+	header.record_count = (uint32_t)record_count;
+	header.slot_count = slot_count;
+	header.dependency_count = (uint32_t)dependency_count;
+	header.strings_size = strings->length;
+
+	const void* sections[] = { slots, records, dependencies, strings->content };
+	size_t section_sizes[] = { slot_count * sizeof(uint32_t), record_count * sizeof(CacheRecord), dependency_count * sizeof(DependencyRecord), strings->length };
+	int section_count = sizeof(sections) / sizeof(sections[0]);
+	header.checksum = FNV_OFFSET_BASIS;
+	for (int i = 0; i < section_count; i++) {
+		header.checksum = fnv1a_update(header.checksum, sections[i], section_sizes[i]);
+	}
+
 	char cache_path[256];
-	snprintf(cache_path, sizeof(cache_path), "%s/%s", CACHE_DIR, CACHE_FILE);
+	char temp_path[256];
+	get_cache_path(cache_path, sizeof(cache_path), "");
+	get_cache_path(temp_path, sizeof(temp_path), ".tmp");
 
-	FILE* file = fopen(cache_path, "w");
+	FILE* file = fopen(temp_path, "wb");
 	if (!file) {
-		fprintf(stderr, "Error: Could not open cache file for writing: %s\n", cache_path);
-		return;
-	}
-	
-	for (int i = 0; i < cache->size; ++i) {
-		HashEntry* entry = cache->entries[i];
-		while (entry) {
-			fprintf(file, "%s\t%s\n", entry->key, (char*)entry->value);
-			entry = entry->next;
+		fprintf(stderr, "Error: Could not open cache file for writing: %s\n", temp_path);
+	} else {
+		bool ok = write_all(file, &header, sizeof(header));
+		for (int i = 0; i < section_count && ok; i++) {
+			ok = write_all(file, sections[i], section_sizes[i]);
+		}
+		ok = (fflush(file) == 0) && ok;
+		ok = (fsync(fileno(file)) == 0) && ok;
+		ok = (fclose(file) == 0) && ok;
+
+		if (!ok || rename(temp_path, cache_path) != 0) {
+			fprintf(stderr, "Error: Failed to write cache file: %s\n", cache_path);
+			remove(temp_path);
+		} else {
+			// everything journaled is in the cache file now
+			remove_cache_journal();
 		}
 	}
 
-	fclose(file);
+	free(destroy_buffer_and_get_content(strings));
+	free(dependencies);
+	free(records);
+	free(slots);
+	free(sorted);
 }
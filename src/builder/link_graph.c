@@ -0,0 +1,182 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/link_graph.h"
+#include "../include/hash_utils.h"
+#include "../include/site_context.h"
+#include "../libs/cjson/cJSON.h"
+
+static size_t target_index(const LinkGraph* graph, const LinkTarget* target) {
+	return (size_t)(target - graph->resolver->targets);
+}
+
+LinkGraph* create_link_graph(const LinkResolver* resolver) {
+	LinkGraph* graph = calloc(1, sizeof(LinkGraph));
+	graph->resolver = resolver;
+	return graph;
+}
+
+void free_link_graph(LinkGraph* graph) {
+	if (!graph) return;
+	free(graph->edges);
+	free(graph->first_backlink);
+	free(graph->backlink_digests);
+	free(graph);
+}
+
+void add_link_edge(LinkGraph* graph, const LinkTarget* source, const LinkTarget* target) {
+	if (!source || !target || source == target) return;
+
+	if (graph->edge_count == graph->edge_capacity) {
+		graph->edge_capacity = graph->edge_capacity ? graph->edge_capacity * 2 : 256;
+		graph->edges = realloc(graph->edges, graph->edge_capacity * sizeof(LinkEdge));
+	}
+	graph->edges[graph->edge_count++] = (LinkEdge){ .source = source, .target = target };
+}
+
+static int compare_edge_sources(const void* a, const void* b) {
+	const LinkEdge* x = (const LinkEdge*)a;
+	const LinkEdge* y = (const LinkEdge*)b;
+	return strcmp(x->source->node->full_path, y->source->node->full_path);
+}
+
+// What a backlink shows: the source's URL and its title, or its file name
+// when it has none.
+static uint64_t add_backlink_digest(uint64_t hash, const LinkTarget* source) {
+	const NavNode* node = source->node;
+	const char* title = node->meta.title ? node->meta.title : node->name;
+	char has_title = node->meta.title != NULL;
+	hash = fnv1a_update(hash, source->url, strlen(source->url) + 1);
+	hash = fnv1a_update(hash, &has_title, 1);
+	return fnv1a_update(hash, title, strlen(title) + 1);
+}
+
+// Counting sort by target, then each target's sources by path.
+void finish_link_graph(LinkGraph* graph) {
+	size_t target_count = graph->resolver->target_count;
+	size_t* first = calloc(target_count + 1, sizeof(size_t));
+
+	for (size_t i = 0; i < graph->edge_count; i++) {
+		first[target_index(graph, graph->edges[i].target) + 1]++;
+	}
+	for (size_t t = 0; t < target_count; t++) {
+		first[t + 1] += first[t];
+	}
+
+	LinkEdge* grouped = malloc((graph->edge_count ? graph->edge_count : 1) * sizeof(LinkEdge));
+	size_t* next = malloc((target_count ? target_count : 1) * sizeof(size_t));
+	memcpy(next, first, target_count * sizeof(size_t));
+	for (size_t i = 0; i < graph->edge_count; i++) {
+		grouped[next[target_index(graph, graph->edges[i].target)]++] = graph->edges[i];
+	}
+	free(next);
+
+	// a page that links the same target twice counts once
+	uint64_t* digests = malloc((target_count ? target_count : 1) * sizeof(uint64_t));
+	size_t kept = 0;
+	for (size_t t = 0; t < target_count; t++) {
+		size_t begin = first[t], end = first[t + 1];
+		qsort(grouped + begin, end - begin, sizeof(LinkEdge), compare_edge_sources);
+		first[t] = kept;
+		digests[t] = FNV_OFFSET_BASIS;
+		for (size_t i = begin; i < end; i++) {
+			if (i > begin && grouped[i].source == grouped[i - 1].source) continue;
+			grouped[kept++] = grouped[i];
+			digests[t] = add_backlink_digest(digests[t], grouped[i].source);
+		}
+	}
+	first[target_count] = kept;
+
+	free(graph->edges);
+	graph->edges = grouped;
+	graph->edge_count = kept;
+	graph->edge_capacity = kept;
+	free(graph->first_backlink);
+	graph->first_backlink = first;
+	free(graph->backlink_digests);
+	graph->backlink_digests = digests;
+}
+
+size_t get_backlinks(const LinkGraph* graph, const NavNode* node, const LinkEdge** backlinks) {
+	const LinkTarget* target = link_target_of_node(graph->resolver, node);
+	*backlinks = NULL;
+	if (!target || !graph->first_backlink) return 0;
+
+	size_t t = target_index(graph, target);
+	*backlinks = graph->edges + graph->first_backlink[t];
+	return graph->first_backlink[t + 1] - graph->first_backlink[t];
+}
+
+uint64_t get_backlinks_digest(const LinkGraph* graph, const NavNode* node) {
+	const LinkTarget* target = link_target_of_node(graph->resolver, node);
+	if (!target || !graph->backlink_digests) return FNV_OFFSET_BASIS;
+	return graph->backlink_digests[target_index(graph, target)];
+}
+
+static int compare_target_paths(const void* a, const void* b) {
+	const LinkTarget* x = *(const LinkTarget* const*)a;
+	const LinkTarget* y = *(const LinkTarget* const*)b;
+	return strcmp(x->node->full_path, y->node->full_path);
+}
+
+static void add_node_json(cJSON* nodes, const LinkTarget* target) {
+	const NavNode* node = target->node;
+	cJSON* item = cJSON_CreateObject();
+	cJSON_AddStringToObject(item, "path", node->full_path);
+	cJSON_AddStringToObject(item, "url", target->url);
+
+	if (node->meta.title) {
+		cJSON_AddStringToObject(item, "title", node->meta.title);
+	} else {
+		char* title = strdup(node->name);
+		char* dot = strrchr(title, '.');
+		if (dot && strcmp(dot, ".md") == 0) *dot = '\0';
+		cJSON_AddStringToObject(item, "title", title);
+		free(title);
+	}
+	cJSON_AddItemToArray(nodes, item);
+}
+
+char* link_graph_to_json(const LinkGraph* graph) {
+	size_t target_count = graph->resolver->target_count;
+
+	// node id of every target that has an edge, in path order
+	size_t* node_ids = malloc((target_count ? target_count : 1) * sizeof(size_t));
+	const LinkTarget** used = malloc((target_count ? target_count : 1) * sizeof(LinkTarget*));
+	size_t used_count = 0;
+	bool* seen = calloc(target_count ? target_count : 1, sizeof(bool));
+	for (size_t i = 0; i < graph->edge_count; i++) {
+		const LinkTarget* ends[] = { graph->edges[i].source, graph->edges[i].target };
+		for (int e = 0; e < 2; e++) {
+			size_t t = target_index(graph, ends[e]);
+			if (!seen[t]) {
+				seen[t] = true;
+				used[used_count++] = ends[e];
+			}
+		}
+	}
+	qsort(used, used_count, sizeof(LinkTarget*), compare_target_paths);
+
+	cJSON* root = cJSON_CreateObject();
+	cJSON* nodes = cJSON_AddArrayToObject(root, "nodes");
+	for (size_t i = 0; i < used_count; i++) {
+		node_ids[target_index(graph, used[i])] = i;
+		add_node_json(nodes, used[i]);
+	}
+
+	cJSON* links = cJSON_AddArrayToObject(root, "links");
+	for (size_t i = 0; i < graph->edge_count; i++) {
+		cJSON* pair = cJSON_CreateArray();
+		cJSON_AddItemToArray(pair, cJSON_CreateNumber((double)node_ids[target_index(graph, graph->edges[i].source)]));
+		cJSON_AddItemToArray(pair, cJSON_CreateNumber((double)node_ids[target_index(graph, graph->edges[i].target)]));
+		cJSON_AddItemToArray(links, pair);
+	}
+
+	char* json_text = cJSON_PrintUnformatted(root);
+	cJSON_Delete(root);
+	free(node_ids);
+	free(used);
+	free(seen);
+	return json_text;
+}
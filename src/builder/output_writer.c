@@ -0,0 +1,240 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "../include/output_writer.h"
+#include "../include/file_utils.h"
+#include "../include/dynamic_buffer.h"
+#include "../libs/cjson/cJSON.h"
+
+typedef enum {
+	CHANGE_CREATED,
+	CHANGE_MODIFIED,
+	CHANGE_DELETED,
+} OutputChangeKind;
+
+typedef struct {
+	OutputChangeKind kind;
+	char* path;
+	unsigned char digest[HASH_DIGEST_SIZE];
+	bool has_digest;
+	long long size; // -1 when unknown
+} OutputChange;
+
+static struct {
+	OutputChange* changes;
+	size_t count;
+	size_t capacity;
+	pthread_mutex_t lock;
+} manifest = { NULL, 0, 0, PTHREAD_MUTEX_INITIALIZER };
+
+static const char* change_kind_names[] = { "created", "modified", "deleted" };
+
+static void record_change(OutputChangeKind kind, const char* path, const unsigned char* digest, long long size) {
+	pthread_mutex_lock(&manifest.lock);
+	if (manifest.count == manifest.capacity) {
+		manifest.capacity = manifest.capacity ? manifest.capacity * 2 : 64;
+		manifest.changes = realloc(manifest.changes, manifest.capacity * sizeof(OutputChange));
+	}
+
+	OutputChange* change = &manifest.changes[manifest.count++];
+	change->kind = kind;
+	change->path = strdup(path);
+	change->has_digest = digest != NULL;
+	if (digest) {
+		memcpy(change->digest, digest, HASH_DIGEST_SIZE);
+	}
+	change->size = size;
+	pthread_mutex_unlock(&manifest.lock);
+}
+
+OutputStatus write_output_file(const char* path, const char* content, size_t length, const unsigned char* previous_digest, unsigned char* digest) {
+	generate_buffer_digest(content, length, digest);
+
+	struct stat st;
+	bool exists = stat(path, &st) == 0 && S_ISREG(st.st_mode);
+
+	// the size check catches outputs edited or truncated outside the build
+	if (exists && previous_digest && (size_t)st.st_size == length && memcmp(previous_digest, digest, HASH_DIGEST_SIZE) == 0) {
+		return OUTPUT_UNCHANGED;
+	}
+
+	FILE* out_file = fopen(path, "w");
+	if (!out_file) {
+		return OUTPUT_FAILED;
+	}
+	bool ok = length == 0 || fwrite(content, 1, length, out_file) == length;
+	ok = (fclose(out_file) == 0) && ok;
+	if (!ok) {
+		return OUTPUT_FAILED;
+	}
+
+	record_change(exists ? CHANGE_MODIFIED : CHANGE_CREATED, path, digest, (long long)length);
+	return exists ? OUTPUT_MODIFIED : OUTPUT_CREATED;
+}
+
+OutputStatus write_generated_output(const BuildCache* old_cache, HashTable* new_cache, const char* path, const char* content) {
+	const unsigned char* previous_digest = cache_previous_output_digest(old_cache, path, path);
+
+	unsigned char digest[HASH_DIGEST_SIZE];
+	OutputStatus status = write_output_file(path, content, strlen(content), previous_digest, digest);
+	if (status != OUTPUT_FAILED) {
+		CacheEntry* entry = create_cache_entry(digest, path, NULL);
+		memcpy(entry->output_digest, digest, HASH_DIGEST_SIZE);
+		free_cache_entry(ht_get(new_cache, path));
+		ht_set(new_cache, path, entry);
+	}
+	return status;
+}
+
+OutputStatus copy_output_file(const char* src_path, const char* dest_path) {
+	struct stat src_stat;
+	unsigned char src_digest[HASH_DIGEST_SIZE];
+	if (stat(src_path, &src_stat) != 0 || !generate_file_digest(src_path, src_digest)) {
+		fprintf(stderr, "[ERROR] Failed to open source file: %s\n", src_path);
+		return OUTPUT_FAILED;
+	}
+
+	struct stat dest_stat;
+	bool exists = stat(dest_path, &dest_stat) == 0 && S_ISREG(dest_stat.st_mode);
+	if (exists && dest_stat.st_size == src_stat.st_size) {
+		unsigned char dest_digest[HASH_DIGEST_SIZE];
+		if (generate_file_digest(dest_path, dest_digest) && memcmp(src_digest, dest_digest, HASH_DIGEST_SIZE) == 0) {
+			return OUTPUT_UNCHANGED;
+		}
+	}
+
+	FILE* src_file = fopen(src_path, "rb");
+	FILE* dest_file = fopen(dest_path, "wb");
+	if (!src_file || !dest_file) {
+		if (!src_file) fprintf(stderr, "[ERROR] Failed to open source file: %s\n", src_path);
+		if (!dest_file) fprintf(stderr, "[ERROR] Failed to open destination file: %s\n", dest_path);
+		if (src_file) fclose(src_file);
+		if (dest_file) fclose(dest_file);
+		return OUTPUT_FAILED;
+	}
+
+	char buffer[4096];
+	size_t n;
+	while ((n = fread(buffer, 1, sizeof(buffer), src_file)) > 0) {
+		fwrite(buffer, 1, n, dest_file);
+	}
+	fclose(src_file);
+	fclose(dest_file);
+
+	record_change(exists ? CHANGE_MODIFIED : CHANGE_CREATED, dest_path, src_digest, (long long)src_stat.st_size);
+	return exists ? OUTPUT_MODIFIED : OUTPUT_CREATED;
+}
+
+const char* output_status_name(OutputStatus status) {
+	switch (status) {
+		case OUTPUT_CREATED: return "created";
+		case OUTPUT_MODIFIED: return "modified";
+		case OUTPUT_UNCHANGED: return "unchanged";
+		default: return "failed";
+	}
+}
+
+// previous_digest may be NULL (or all zero) when the deleted bytes are unknown
+bool remove_output_file(const char* path, const unsigned char* previous_digest) {
+	static const unsigned char zero_digest[HASH_DIGEST_SIZE] = { 0 };
+	if (previous_digest && memcmp(previous_digest, zero_digest, HASH_DIGEST_SIZE) == 0) {
+		previous_digest = NULL;
+	}
+
+	struct stat st;
+	long long size = stat(path, &st) == 0 ? (long long)st.st_size : -1;
+	if (remove(path) != 0) return false;
+
+	record_change(CHANGE_DELETED, path, previous_digest, size);
+	return true;
+}
+
+static int compare_changes(const void* a, const void* b) {
+	const OutputChange* change_a = (const OutputChange*)a;
+	const OutputChange* change_b = (const OutputChange*)b;
+	if (change_a->kind != change_b->kind) return (int)change_a->kind - (int)change_b->kind;
+	return strcmp(change_a->path, change_b->path);
+}
+
+static cJSON* change_to_json(const OutputChange* change, bool with_kind) {
+	cJSON* item = cJSON_CreateObject();
+	if (with_kind) {
+		cJSON_AddStringToObject(item, "change", change_kind_names[change->kind]);
+	}
+	cJSON_AddStringToObject(item, "path", change->path);
+	if (change->has_digest) {
+		char hex[HASH_HEX_LENGTH + 1];
+		digest_to_hex_string(change->digest, hex);
+		cJSON_AddStringToObject(item, "sha256", hex);
+	} else {
+		cJSON_AddNullToObject(item, "sha256");
+	}
+	if (change->size >= 0) {
+		cJSON_AddNumberToObject(item, "size", (double)change->size);
+	} else {
+		cJSON_AddNullToObject(item, "size");
+	}
+	return item;
+}
+
+static void write_text_file(const char* path, const char* content) {
+	FILE* file = fopen(path, "w");
+	if (!file) {
+		fprintf(stderr, "Error: Could not write deploy manifest: %s\n", path);
+		return;
+	}
+	fputs(content, file);
+	fclose(file);
+}
+
+void write_deploy_manifest() {
+	pthread_mutex_lock(&manifest.lock);
+	qsort(manifest.changes, manifest.count, sizeof(OutputChange), compare_changes);
+
+	cJSON* root = cJSON_CreateObject();
+	cJSON* groups[3];
+	for (int kind = CHANGE_CREATED; kind <= CHANGE_DELETED; kind++) {
+		groups[kind] = cJSON_AddArrayToObject(root, change_kind_names[kind]);
+	}
+
+	DynamicBuffer* ndjson = create_dynamic_buffer(4096);
+	for (size_t i = 0; i < manifest.count; i++) {
+		const OutputChange* change = &manifest.changes[i];
+		cJSON_AddItemToArray(groups[change->kind], change_to_json(change, false));
+
+		cJSON* line = change_to_json(change, true);
+		char* line_text = cJSON_PrintUnformatted(line);
+		buffer_append_formatted(ndjson, "%s\n", line_text);
+		free(line_text);
+		cJSON_Delete(line);
+	}
+
+	char path[256];
+	char* json_text = cJSON_Print(root);
+	snprintf(path, sizeof(path), "%s/%s.json", CACHE_DIR, DEPLOY_MANIFEST_FILE);
+	write_text_file(path, json_text);
+	snprintf(path, sizeof(path), "%s/%s.ndjson", CACHE_DIR, DEPLOY_MANIFEST_FILE);
+	write_text_file(path, ndjson->content);
+
+	printf("Deploy manifest: %zu change(s) written to %s/%s.json\n", manifest.count, CACHE_DIR, DEPLOY_MANIFEST_FILE);
+
+	free(json_text);
+	free(destroy_buffer_and_get_content(ndjson));
+	cJSON_Delete(root);
+	pthread_mutex_unlock(&manifest.lock);
+}
+
+void free_deploy_manifest() {
+	pthread_mutex_lock(&manifest.lock);
+	for (size_t i = 0; i < manifest.count; i++) {
+		free(manifest.changes[i].path);
+	}
+	free(manifest.changes);
+	manifest.changes = NULL;
+	manifest.count = 0;
+	manifest.capacity = 0;
+	pthread_mutex_unlock(&manifest.lock);
+}
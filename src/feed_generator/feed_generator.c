@@ -8,6 +8,7 @@
 #include "../include/feed_generator.h"
 #include "../include/dynamic_buffer.h"
 #include "../include/build_process.h"
+#include "../include/output_writer.h"
 
 #define MAX_PATH_LENGTH 1024
 
@@ -68,7 +69,7 @@ static void format_date_to_rfc822(const char* date_str, char* buf, size_t buf_si
 	strftime(buf, buf_size, "%a, %d %b %Y %H:%M:%S GMT", &tm);
 }
 
-void generate_sitemap(SiteContext* s_context, struct list_head* all_posts, TemplateContext* global_context) {
+void generate_sitemap(SiteContext* s_context, struct list_head* all_posts, TemplateContext* global_context, const BuildCache* old_cache, HashTable* new_cache) {
 	const char* base_url = get_from_context(global_context, "base_url");
 	if (!base_url) return;
 
@@ -108,16 +109,14 @@ void generate_sitemap(SiteContext* s_context, struct list_head* all_posts, Templ
 	snprintf(output_path, sizeof(output_path), "%s/sitemap.xml", output_dir ? output_dir : "ssg_output");
 
 	char* sitemap_content = destroy_buffer_and_get_content(db);
-	FILE* out_file = fopen(output_path, "w");
-	if (out_file) {
-		fprintf(out_file, "%s", sitemap_content);
-		fclose(out_file);
-		printf(" - Generated sitemap (using git): %s\n", output_path);
+	OutputStatus status = write_generated_output(old_cache, new_cache, output_path, sitemap_content);
+	if (status != OUTPUT_FAILED) {
+		printf(" - Generated sitemap (using git, %s): %s\n", output_status_name(status), output_path);
 	}
 	free(sitemap_content);
 }
 
-void generate_rss_feed(struct list_head* all_posts, TemplateContext* global_context) {
+void generate_rss_feed(struct list_head* all_posts, TemplateContext* global_context, const BuildCache* old_cache, HashTable* new_cache) {
 	const char* base_url = get_from_context(global_context, "base_url");
 	const char* site_title = get_from_context(global_context, "site_title");
 	const char* site_description = get_from_context(global_context, "site_description");
@@ -166,11 +165,9 @@ void generate_rss_feed(struct list_head* all_posts, TemplateContext* global_cont
 	snprintf(output_path, sizeof(output_path), "%s/rss.xml", output_dir ? output_dir : "ssg_output");
 
 	char* rss_content = destroy_buffer_and_get_content(db);
-	FILE* out_file = fopen(output_path, "w");
-	if (out_file) {
-		fprintf(out_file, "%s", rss_content);
-		fclose(out_file);
-		printf(" - Generated RSS feed: %s\n", output_path);
+	OutputStatus status = write_generated_output(old_cache, new_cache, output_path, rss_content);
+	if (status != OUTPUT_FAILED) {
+		printf(" - Generated RSS feed (%s): %s\n", output_status_name(status), output_path);
 	}
 
 	free(rss_content);
@@ -23,39 +23,32 @@ static bool is_inline_node(const AstNode* node) {
 	}
 }
 
-static void render_node_recursively(const AstNode* node, DynamicBuffer* buffer, TemplateContext* context);
+static void render_node_recursively(const Ast* ast, AstNodeId id, DynamicBuffer* buffer, TemplateContext* context);
 
-static void build_toc_recursively(const AstNode* node, DynamicBuffer* buffer) {
-	if (!node) return;
+// Headings are the only nodes the TOC needs, and pre-order is document
+// order, so a single pass over the node array finds them.
+char* generate_toc_from_ast(const Ast* ast) {
+	if (!ast) return NULL;
+
+	DynamicBuffer* buffer = create_dynamic_buffer(1024);
+	buffer_append_formatted(buffer, "<ul class=\"toc-list\">\n");
 
-	if (node->type == NODE_HEADING1 || node->type == NODE_HEADING2 || node->type == NODE_HEADING3) {
-		char* anchor_id = generate_anchor_id(node->data1);
+	for (size_t i = 0; i < ast->node_count; i++) {
+		const AstNode* node = &ast->nodes[i];
+		if (node->type != NODE_HEADING1 && node->type != NODE_HEADING2 && node->type != NODE_HEADING3) continue;
+
+		const char* text = ast_data1(ast, node);
+		char* anchor_id = generate_anchor_id(text);
 		int level = (node->type == NODE_HEADING1) ? 1 : ((node->type == NODE_HEADING2) ? 2 : 3);
 
 		int margin_left = (level - 1) * 15;
 
 		buffer_append_formatted(buffer,
 				"<li class=\"toc-level-%d\" style=\"margin-left: %dpx;\"><a href=\"#%s\">%s</a></li>\n",
-				level, margin_left, anchor_id, node->data1);
+				level, margin_left, anchor_id, text);
 
 		free(anchor_id);
 	}
-
-	if (!list_empty(&node->children)) {
-		AstNode* child;
-		list_for_each_entry(child, &node->children, list) {
-			build_toc_recursively(child, buffer);
-		}
-	}
-}
-
-char* generate_toc_from_ast(AstNode* ast_root) {
-	if (!ast_root) return NULL;
-
-	DynamicBuffer* buffer = create_dynamic_buffer(1024);
-	buffer_append_formatted(buffer, "<ul class=\"toc-list\">\n");
-
-	build_toc_recursively(ast_root, buffer);
 	buffer_append_formatted(buffer, "</ul>\n");
 
 	if (buffer->length <= 25) {
@@ -66,8 +59,8 @@ char* generate_toc_from_ast(AstNode* ast_root) {
 	return destroy_buffer_and_get_content(buffer);
 }
 
-char* generate_html_from_ast(AstNode* ast_root, TemplateContext* context) {
-	if (!ast_root) return NULL;
+char* generate_html_from_ast(const Ast* ast, TemplateContext* context) {
+	if (!ast) return NULL;
 
 	DynamicBuffer* buffer = create_dynamic_buffer(4096);
 	if (!buffer) {
@@ -75,12 +68,13 @@ char* generate_html_from_ast(AstNode* ast_root, TemplateContext* context) {
 		return NULL;
 	}
 
-	render_node_recursively(ast_root, buffer, context);
+	render_node_recursively(ast, 0, buffer, context);
 
 	return destroy_buffer_and_get_content(buffer);
 }
 
-static void render_node_recursively(const AstNode* node, DynamicBuffer* buffer, TemplateContext* context) {
+static void render_node_recursively(const Ast* ast, AstNodeId id, DynamicBuffer* buffer, TemplateContext* context) {
+	const AstNode* node = ast_node(ast, id);
 	if (!node) return;
 
 	if (node->type == NODE_DOCUMENT) {
@@ -88,16 +82,13 @@ static void render_node_recursively(const AstNode* node, DynamicBuffer* buffer,
 	} else if (node->type == NODE_LINE) {
 		render_self_closing_node(node, buffer);
 	} else if (is_inline_node(node)) {
-		render_inline_node(node, buffer, context);
+		render_inline_node(ast, node, buffer, context);
 	} else {
-		render_opening_tag_for_node(node, buffer);
+		render_opening_tag_for_node(ast, node, buffer);
 	}
 
-	if (!list_empty(&node->children)) {
-		AstNode* child;
-		list_for_each_entry(child, &node->children, list) {
-			render_node_recursively(child, buffer, context);
-		}
+	for (AstNodeId child = node->first_child; child != AST_NONE; child = ast->nodes[child].next_sibling) {
+		render_node_recursively(ast, child, buffer, context);
 	}
 
 	if (node->type < NODE_TEXT) {
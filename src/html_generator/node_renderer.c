@@ -51,29 +51,33 @@ static void append_escaped_html(DynamicBuffer* buffer, const char* text) {
 	}
 }
 
-void render_opening_tag_for_node(const AstNode* node, DynamicBuffer* buffer) {
+void render_opening_tag_for_node(const Ast* ast, const AstNode* node, DynamicBuffer* buffer) {
+	const char* data1 = ast_data1(ast, node);
+	const char* data2 = ast_data2(ast, node);
+
 	switch (node->type) {
 		case NODE_HEADING1:
 		case NODE_HEADING2:
 		case NODE_HEADING3: {
-			char* id = generate_anchor_id(node->data1);
+			char* id = generate_anchor_id(data1);
 			int level = (node->type == NODE_HEADING1) ? 1 : ((node->type == NODE_HEADING2) ? 2 : 3);
-			buffer_append_formatted(buffer, "<h%d id=\"%s\">%s", level, id, node->data1);
+			buffer_append_formatted(buffer, "<h%d id=\"%s\">%s", level, id, data1);
 			free(id);
 			break;
 		}
-		case NODE_PARAGRAPH:        buffer_append_formatted(buffer, "<p>"); break;
-		case NODE_BLOCKQUOTE:				buffer_append_formatted(buffer, "<blockquote>\n"); break;
+		// data1 of these is the block id, the target of [[note#^id]]
+		case NODE_PARAGRAPH:        buffer_append_formatted(buffer, data1 ? "<p id=\"%s\">" : "<p>", data1); break;
+		case NODE_BLOCKQUOTE:				buffer_append_formatted(buffer, data1 ? "<blockquote id=\"%s\">\n" : "<blockquote>\n", data1); break;
 		case NODE_ORDERED_LIST:     buffer_append_formatted(buffer, "<ol>\n"); break;
 		case NODE_UNORDERED_LIST:   buffer_append_formatted(buffer, "<ul>\n"); break;
-		case NODE_LIST_ITEM:        buffer_append_formatted(buffer, "<li>"); break;
+		case NODE_LIST_ITEM:        buffer_append_formatted(buffer, data1 ? "<li id=\"%s\">" : "<li>", data1); break;
 		case NODE_CODE_BLOCK:
-			if (node->data2) {
-				buffer_append_formatted(buffer, "<pre><code class=\"language-%s\">", node->data2);
+			if (data2) {
+				buffer_append_formatted(buffer, "<pre><code class=\"language-%s\">", data2);
 			} else {
 				buffer_append_formatted(buffer, "<pre><code>");
 			}
-			append_escaped_html(buffer, node->data1);
+			append_escaped_html(buffer, data1);
 			break;
 		default: break;
 	}
@@ -94,39 +98,42 @@ void render_closing_tag_for_node(const AstNode* node, DynamicBuffer* buffer) {
 	}
 }
 
-void render_inline_node(const AstNode* node, DynamicBuffer* buffer, TemplateContext* context) {
+void render_inline_node(const Ast* ast, const AstNode* node, DynamicBuffer* buffer, TemplateContext* context) {
+	const char* data1 = ast_data1(ast, node);
+	const char* data2 = ast_data2(ast, node);
+
 	switch (node->type) {
-		case NODE_TEXT:             buffer_append_formatted(buffer, "%s", node->data1); break;
-		case NODE_ITALIC:           buffer_append_formatted(buffer, "<em>%s</em>", node->data1); break;
-		case NODE_BOLD:             buffer_append_formatted(buffer, "<strong>%s</strong>", node->data1); break;
-		case NODE_ITALIC_AND_BOLD:  buffer_append_formatted(buffer, "<em><strong>%s</strong></em>", node->data1); break;
-		case NODE_MATH:							append_escaped_html(buffer, node->data1); break;
+		case NODE_TEXT:             buffer_append_formatted(buffer, "%s", data1); break;
+		case NODE_ITALIC:           buffer_append_formatted(buffer, "<em>%s</em>", data1); break;
+		case NODE_BOLD:             buffer_append_formatted(buffer, "<strong>%s</strong>", data1); break;
+		case NODE_ITALIC_AND_BOLD:  buffer_append_formatted(buffer, "<em><strong>%s</strong></em>", data1); break;
+		case NODE_MATH:							append_escaped_html(buffer, data1); break;
 		case NODE_CODE:
 			buffer_append_formatted(buffer, "<code>");
-			append_escaped_html(buffer, node->data1);
+			append_escaped_html(buffer, data1);
 			buffer_append_formatted(buffer, "</code>");
 			break;
 		case NODE_LINK: {
-			const char* url = node->data2;
+			const char* url = data2;
 			const char* base_url = get_from_context(context, "base_url");
 			if (!base_url) base_url = "";
 
 			if (strncmp(url, "http://", 7) == 0 || strncmp(url, "https://", 8) == 0) {
-				buffer_append_formatted(buffer, "<a href=\"%s\">%s</a>", url, node->data1);
+				buffer_append_formatted(buffer, "<a href=\"%s\">%s</a>", url, data1);
 			} else {
-				buffer_append_formatted(buffer, "<a href=\"%s%s\">%s</a>", base_url, url, node->data1);
+				buffer_append_formatted(buffer, "<a href=\"%s%s\">%s</a>", base_url, url, data1);
 			}
 			break;
 		}
 		case NODE_IMAGE_LINK: {
-			const char* src = node->data2;
+			const char* src = data2;
 			const char* base_url = get_from_context(context, "base_url");
 			if (!base_url) base_url = "";
 
 			if (strncmp(src, "http://", 7) == 0 || strncmp(src, "https://", 8) == 0) {
-				buffer_append_formatted(buffer, "<img src=\"%s\" alt=\"%s\">", src, node->data1);
+				buffer_append_formatted(buffer, "<img src=\"%s\" alt=\"%s\">", src, data1);
 			} else {
-				buffer_append_formatted(buffer, "<img src=\"%s%s\" alt=\"%s\">", base_url, src, node->data1);
+				buffer_append_formatted(buffer, "<img src=\"%s%s\" alt=\"%s\">", base_url, src, data1);
 			}
 			break;
 		}
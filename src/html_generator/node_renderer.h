@@ -1,12 +1,12 @@
 #pragma once
 
 #include "../include/parser.h"
+#include "../include/html_generator.h"
 #include "../include/dynamic_buffer.h"
 #include "../include/template_engine.h"
 
-char* generate_anchor_id(const char* text);
-void render_opening_tag_for_node(const AstNode* node, DynamicBuffer* buffer);
+void render_opening_tag_for_node(const Ast* ast, const AstNode* node, DynamicBuffer* buffer);
 void render_closing_tag_for_node(const AstNode* node, DynamicBuffer* buffer);
-void render_inline_node(const AstNode* node, DynamicBuffer* buffer, TemplateContext* context);
+void render_inline_node(const Ast* ast, const AstNode* node, DynamicBuffer* buffer, TemplateContext* context);
 void render_self_closing_node(const AstNode* node, DynamicBuffer* buffer);
 
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stddef.h>
+
+// Bump allocator: allocations are carved out of large chunks and are never
+// freed one by one, only all together by arena_reset or arena_free.
+typedef struct ArenaChunk ArenaChunk;
+
+typedef struct {
+	ArenaChunk* chunks; // newest first; allocations come from the head
+	size_t chunk_size;
+} Arena;
+
+Arena* arena_create(size_t chunk_size);
+void* arena_alloc(Arena* arena, size_t size);
+char* arena_strdup(Arena* arena, const char* text);
+char* arena_strndup(Arena* arena, const char* text, size_t length);
+// Drops every allocation but keeps one chunk for the next user.
+void arena_reset(Arena* arena);
+void arena_free(Arena* arena);
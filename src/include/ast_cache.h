@@ -0,0 +1,41 @@
+#pragma once
+
+#include "parser.h"
+#include "hash_table.h"
+#include "hash_utils.h"
+
+#define AST_CACHE_DIR "ast"
+#define AST_CACHE_SUFFIX ".ast"
+#define AST_CACHE_MAGIC "SSGAST\0\0"
+#define AST_CACHE_FORMAT_VERSION 1
+
+/*
+ * Parsed notes, one file per markdown text: <CACHE_DIR>/ast/<digest>.ast,
+ * named after the SHA-256 of the note, in native byte order:
+ *
+ *   AstCacheHeader
+ *   AstNode nodes[node_count]
+ *   AstNodeId links[link_count]
+ *   char strings[strings_size]
+ *
+ * Wikilinks are stored unresolved and resolved again on every load, since
+ * their URLs depend on the rest of the site.
+ */
+typedef struct {
+	char magic[8];
+	uint32_t version;
+	uint32_t parser_version; // PARSER_VERSION of the parser that wrote it
+	uint32_t node_size;
+	uint32_t node_count;
+	uint32_t link_count;
+	uint32_t reserved;
+	uint64_t strings_size;
+	uint64_t checksum;       // FNV-1a over everything after the header
+} AstCacheHeader;
+
+// The unresolved Ast of the markdown with this digest, NULL on a miss.
+Ast* load_cached_ast(const unsigned char* digest);
+// Call before resolve_wikilinks, while the Ast is still unresolved.
+void store_cached_ast(const unsigned char* digest, const Ast* ast);
+// Removes the Asts of notes that are no longer in the cache being saved.
+void prune_ast_cache(const HashTable* cache);
@@ -3,6 +3,7 @@
 #include "site_context.h"
 #include "template_engine.h"
 #include "list_head.h"
+#include "cache_manager.h"
 
 typedef struct {
 	NavNode* node;
@@ -13,6 +14,11 @@ typedef struct {
 	struct list_head list;
 } PostSortInfo;
 
-void build_site(const char* vault_path, SiteContext* s_context, TemplateContext* global_context, HashTable* old_cache, HashTable* new_cache, struct list_head* all_posts);
+typedef struct {
+	int jobs; // number of render threads, 1 keeps the build serial
+	bool paranoid; // always hash sources instead of trusting unchanged stat() stamps
+} BuildOptions;
+
+void build_site(const char* vault_path, SiteContext* s_context, TemplateContext* global_context, BuildCache* old_cache, HashTable* new_cache, struct list_head* all_posts, const BuildOptions* options);
 int compare_posts(const void* a, const void* b);
 
@@ -1,11 +1,120 @@
 #pragma once
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include "hash_table.h"
+#include "hash_utils.h"
+#include "file_utils.h"
+#include "dependency_tracker.h"
+#include "source_document.h"
 
 #define CACHE_DIR ".ssg_cache"
 #define CACHE_FILE "build.cache"
+#define CACHE_JOURNAL_FILE "build.journal"
+
+#define CACHE_MAGIC "SSGCACHE"
+#define CACHE_JOURNAL_MAGIC "SSGJOURN"
+#define CACHE_FORMAT_VERSION 8
+#define CACHE_NO_STRING UINT32_MAX
+
+/*
+ * On-disk layout (native byte order, every section 8-byte aligned):
+ *
+ *   CacheFileHeader
+ *   uint32_t slots[slot_count]      open-addressing index, record index + 1, 0 = empty
+ *   CacheRecord records[record_count]   sorted by key
+ *   DependencyRecord dependencies[dependency_count]   grouped per record
+ *   char strings[strings_size]      NUL-terminated keys, output paths and dependency names
+ */
+typedef struct {
+	char magic[8];
+	uint32_t version;
+	uint32_t record_size;
+	uint32_t record_count;
+	uint32_t slot_count;    // power of two
+	uint32_t dependency_count;
+	uint32_t reserved;
+	uint64_t strings_size;
+	uint64_t checksum;      // FNV-1a over everything after the header
+} CacheFileHeader;
+
+typedef struct {
+	uint64_t key_hash;
+	uint32_t key_offset;
+	uint32_t output_offset;
+	uint32_t dependency_index;
+	uint32_t dependency_count;
+
+	// note metadata, string offsets are CACHE_NO_STRING when absent
+	uint32_t slug_offset;
+	uint32_t excerpt_offset;
+	uint32_t title_offset;
+	uint32_t date_offset;
+	int32_t id;
+	int32_t order;
+	uint32_t has_order;
+	uint32_t aliases_offset;
+
+	int64_t mtime_sec;
+	int64_t mtime_nsec;
+	int64_t ctime_sec;
+	int64_t ctime_nsec;
+	int64_t size;
+	uint64_t inode;
+	uint8_t digest[HASH_DIGEST_SIZE];
+	uint8_t output_digest[HASH_DIGEST_SIZE]; // SHA-256 of the bytes written to output_path
+} CacheRecord;
+
+typedef struct {
+	uint32_t kind;          // DependencyKind
+	uint32_t name_offset;
+	uint8_t digest[HASH_DIGEST_SIZE];
+} DependencyRecord;
+
+// read-only view of the previous build's cache, mmapped from disk
+typedef struct {
+	void* map;
+	size_t map_size;
+
+	const CacheFileHeader* header;
+	const uint32_t* slots;
+	const CacheRecord* records;
+	const DependencyRecord* dependencies;
+	const char* strings;
+	size_t record_count;
+} BuildCache;
+
+// entry of the cache being produced by the current build
+typedef struct {
+	unsigned char digest[HASH_DIGEST_SIZE];
+	unsigned char output_digest[HASH_DIGEST_SIZE];
+	char* output_path;
+	FileStamp stamp;
+	DependencyList dependencies;
+	NoteMetadata metadata;
+} CacheEntry;
 
 int ensure_cache_dir_exists();
-HashTable* load_cache();
+BuildCache* load_cache();
+void unload_cache(BuildCache* cache);
 void save_cache(const HashTable* cache);
 
+const CacheRecord* cache_lookup(const BuildCache* cache, const char* key);
+const CacheRecord* cache_record_at(const BuildCache* cache, size_t index);
+const char* cache_record_key(const BuildCache* cache, const CacheRecord* record);
+const char* cache_record_output_path(const BuildCache* cache, const CacheRecord* record);
+const unsigned char* cache_previous_output_digest(const BuildCache* cache, const char* key, const char* output_path);
+void cache_record_stamp(const CacheRecord* record, FileStamp* stamp);
+void cache_record_metadata(const BuildCache* cache, const CacheRecord* record, NoteMetadata* metadata);
+const DependencyRecord* cache_record_dependencies(const BuildCache* cache, const CacheRecord* record);
+const char* cache_dependency_name(const BuildCache* cache, const DependencyRecord* dependency);
+
+// journal of entries finished since the last save_cache(), see cache_journal.c
+void append_cache_journal(const char* key, const CacheEntry* entry);
+size_t replay_cache_journal(HashTable* entries);
+void close_cache_journal();
+void remove_cache_journal();
+
+CacheEntry* create_cache_entry(const unsigned char* digest, const char* output_path, const FileStamp* stamp);
+void free_cache_entry(void* entry);
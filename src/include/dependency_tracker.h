@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "hash_utils.h"
+#include "template_engine.h"
+
+typedef enum {
+	DEP_TEMPLATE = 0, // layout or component file, digest of its content
+	DEP_CONFIG,       // key read from the global context, digest of its value
+	DEP_LINK,         // wikilink target, digest of the URL it resolved to
+	DEP_VALUE,        // page value computed by the builder (series navigation)
+} DependencyKind;
+
+typedef struct {
+	DependencyKind kind;
+	char* name;
+	unsigned char digest[HASH_DIGEST_SIZE]; // all zero when the input did not exist
+} Dependency;
+
+typedef struct {
+	Dependency* items;
+	size_t count;
+	size_t capacity;
+} DependencyList;
+
+void dependency_list_init(DependencyList* list);
+void dependency_list_add(DependencyList* list, DependencyKind kind, const char* name, const unsigned char* digest);
+void dependency_list_free(DependencyList* list);
+void dependency_digest(const char* value, unsigned char* digest);
+
+// Recording is per thread: everything the current thread renders between
+// start and stop is added to the list.
+void start_dependency_recording(DependencyList* list, TemplateContext* global_context);
+void stop_dependency_recording();
+
+void record_template_dependency(const char* path, const char* content);
+void record_context_lookup(TemplateContext* context, const char* key, const char* value);
+void record_link_dependency(const char* target, const char* url);
+void record_value_dependency(const char* key, const char* value);
+// For a value whose digest is cheaper to get than the value itself.
+void record_value_digest(const char* key, const unsigned char* digest);
@@ -10,5 +10,6 @@ typedef struct DynamicBuffer {
 
 DynamicBuffer* create_dynamic_buffer(size_t initial_capacity);
 void buffer_append_formatted(DynamicBuffer* buffer, const char* format, ...);
+void buffer_append_bytes(DynamicBuffer* buffer, const void* data, size_t length);
 char* destroy_buffer_and_get_content(DynamicBuffer* buffer);
 
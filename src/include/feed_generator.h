@@ -3,7 +3,8 @@
 #include "site_context.h"
 #include "list_head.h"
 #include "template_engine.h"
+#include "cache_manager.h"
 
-void generate_sitemap(SiteContext* s_context, struct list_head* all_posts, TemplateContext* global_context);
-void generate_rss_feed(struct list_head* all_posts, TemplateContext* global_context);
+void generate_sitemap(SiteContext* s_context, struct list_head* all_posts, TemplateContext* global_context, const BuildCache* old_cache, HashTable* new_cache);
+void generate_rss_feed(struct list_head* all_posts, TemplateContext* global_context, const BuildCache* old_cache, HashTable* new_cache);
 
@@ -1,8 +1,22 @@
 #pragma once
 
+#include <stdbool.h>
+#include <sys/stat.h>
+
+// stat() fields used to detect a changed file without reading it
+typedef struct {
+	long long mtime_sec;
+	long mtime_nsec;
+	long long ctime_sec;
+	long ctime_nsec;
+	long long size;
+	unsigned long long inode; // 0 means "no stamp recorded"
+} FileStamp;
+
 char* read_file_into_string(const char* filepath);
 int mkdir_p(const char* path);
 void create_parent_directories(const char* file_path);
 void copy_static_files(const char* src_dir, const char* dest_dir);
 int check_path_type(const char* path);
-
+void file_stamp_from_stat(const struct stat* st, FileStamp* stamp);
+bool file_stamp_equal(const FileStamp* a, const FileStamp* b);
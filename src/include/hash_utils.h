@@ -1,4 +1,19 @@
 #pragma once
 
-char* generate_file_hash(const char* file_path);
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define HASH_DIGEST_SIZE 32
+#define HASH_HEX_LENGTH (HASH_DIGEST_SIZE * 2)
 
+// FNV-1a, for checksums and hash-table keys where SHA-256 is overkill
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+
+char* generate_file_hash(const char* file_path);
+bool generate_file_digest(const char* file_path, unsigned char* digest);
+char* generate_buffer_hash(const void* data, size_t length);
+void generate_buffer_digest(const void* data, size_t length, unsigned char* digest);
+void digest_to_hex_string(const unsigned char* digest, char* hex_out);
+uint64_t fnv1a_update(uint64_t hash, const void* data, size_t length);
+uint64_t fnv1a(const void* data, size_t length);
@@ -2,6 +2,9 @@
 
 #include "parser.h"
 
-char* generate_toc_from_ast(AstNode* ast_root);
-char* generate_html_from_ast(AstNode* ast_root, TemplateContext* context);
+char* generate_toc_from_ast(const Ast* ast);
+char* generate_html_from_ast(const Ast* ast, TemplateContext* context);
+
+// The id of a heading's anchor; [[note#heading]] links resolve to it too.
+char* generate_anchor_id(const char* text);
 
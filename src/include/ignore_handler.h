@@ -3,5 +3,6 @@
 #include <stdbool.h>
 
 void load_ssgignore(const char* base_path);
+void ignore_directory(const char* base_path, const char* directory);
 bool is_ignored(const char* path);
 void free_ignore_patterns();
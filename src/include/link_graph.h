@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "link_resolver.h"
+
+#define LINK_GRAPH_FILE "graph.json"
+
+struct NavNode;
+
+typedef struct {
+	const LinkTarget* source;
+	const LinkTarget* target;
+} LinkEdge;
+
+/*
+ * Resolved wikilinks between the pages of one build. Edges are added before
+ * rendering starts; finish_link_graph() then groups them by target, so the
+ * backlinks of a page are one lookup and the graph is read-only while the
+ * render threads use it.
+ */
+typedef struct {
+	const LinkResolver* resolver;
+	LinkEdge* edges;
+	size_t edge_count;
+	size_t edge_capacity;
+
+	// edges grouped by target index: backlinks of target i are
+	// edges[first_backlink[i] .. first_backlink[i + 1]), sorted by source path
+	size_t* first_backlink;
+	// FNV-1a of the URL and title of each backlink of target i, in order
+	uint64_t* backlink_digests;
+} LinkGraph;
+
+LinkGraph* create_link_graph(const LinkResolver* resolver);
+void free_link_graph(LinkGraph* graph);
+
+// Not thread-safe; self links are dropped.
+void add_link_edge(LinkGraph* graph, const LinkTarget* source, const LinkTarget* target);
+// Groups the edges by target and drops duplicates. O(edges + targets).
+void finish_link_graph(LinkGraph* graph);
+
+// Pages linking to node, sorted by path. Only valid after finish_link_graph().
+size_t get_backlinks(const LinkGraph* graph, const struct NavNode* node, const LinkEdge** backlinks);
+// Changes whenever the backlinks of node would render differently, without
+// rendering them. Only valid after finish_link_graph().
+uint64_t get_backlinks_digest(const LinkGraph* graph, const struct NavNode* node);
+
+// {"nodes":[{"path","url","title"}...],"links":[[source,target]...]}: every
+// page or file with at least one edge, sorted by path, and the edges as
+// indices into nodes.
+char* link_graph_to_json(const LinkGraph* graph);
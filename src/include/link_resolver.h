@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "hash_table.h"
+#include "hash_utils.h"
+
+struct NavNode;
+
+// Something a [[wikilink]] can point at, with its URL (relative to base_url)
+// built once for the whole build. url_digest is the digest a link dependency
+// records for the URL, so checking one does not hash it again.
+typedef struct {
+	struct NavNode* node;
+	char* url;
+	unsigned char url_digest[HASH_DIGEST_SIZE];
+} LinkTarget;
+
+// A heading or block of a note's page, as "url#anchor".
+typedef struct {
+	char* url;
+	unsigned char url_digest[HASH_DIGEST_SIZE];
+} LinkAnchor;
+
+// A key that several targets of the same rank share; links go to `chosen`.
+typedef struct {
+	char* key;
+	const LinkTarget* chosen;
+	const LinkTarget* other;
+} LinkAmbiguity;
+
+/*
+ * Wikilink lookup table, built once from the scanned tree and read-only
+ * afterwards, so render threads share it without locking.
+ *
+ * Every note, file and directory is registered under its vault path and its
+ * name, and notes also under their front-matter aliases. Keys are normalised
+ * (see normalize_link_key), so [[Note]], [[note]] and [[note.md]] hit the
+ * same entry. When keys collide the exact path wins over a name, a name over
+ * an alias, and a note over a directory; ties go to the shortest path.
+ *
+ * The heading and block anchors of notes are added once the notes are parsed,
+ * before anything renders, so [[note#heading]] and [[note#^block]] are one
+ * more lookup rather than a parse of the target note.
+ */
+typedef struct {
+	HashTable* keys;        // normalised key -> const LinkTarget*
+	HashTable* by_path;     // NavNode full_path -> its own LinkTarget
+	HashTable* anchors;     // "url#anchor" -> LinkAnchor, owned
+	LinkTarget* targets;
+	size_t target_count;
+	LinkAmbiguity* ambiguities;
+	size_t ambiguity_count;
+} LinkResolver;
+
+LinkResolver* create_link_resolver(struct NavNode* root);
+void free_link_resolver(LinkResolver* resolver);
+
+// The target of a wikilink, NULL if nothing in the site matches it. A
+// "#heading", "#^block" or "^block" fragment is ignored.
+const LinkTarget* resolve_link_target(const LinkResolver* resolver, const char* link_target);
+// The fragment of a wikilink starting at its '#' or '^', NULL if it has none.
+const char* find_link_fragment(const char* link_target);
+// Registers an anchor id of a note's page: a heading id from
+// generate_anchor_id(), or a block id without its caret. Not thread-safe.
+void add_link_anchor(LinkResolver* resolver, const LinkTarget* target, const char* anchor_id);
+// The anchor for a fragment of target, NULL if the note has no such
+// heading or block.
+const LinkAnchor* resolve_link_anchor(const LinkResolver* resolver, const LinkTarget* target, const char* fragment);
+// The entry of a scanned node itself, NULL for the root.
+const LinkTarget* link_target_of_node(const LinkResolver* resolver, const struct NavNode* node);
+// Prints one warning per ambiguous key to stderr.
+void report_link_ambiguities(const LinkResolver* resolver);
+
+// Writes the lookup key of text to out, which needs strlen(text) + 1 bytes:
+// NFC for Hangul and precomposed Latin letters, lower case for Latin, Greek
+// and Cyrillic letters, and a trailing ".md" removed.
+size_t normalize_link_key(const char* text, char* out);
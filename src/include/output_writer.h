@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "hash_table.h"
+#include "hash_utils.h"
+#include "cache_manager.h"
+
+#define DEPLOY_MANIFEST_FILE "deploy_manifest"
+
+typedef enum {
+	OUTPUT_CREATED,
+	OUTPUT_MODIFIED,
+	OUTPUT_UNCHANGED, // same bytes as the previous build, file left untouched
+	OUTPUT_FAILED,
+} OutputStatus;
+
+// Writes content to path unless previous_digest (may be NULL) says the file
+// already holds exactly these bytes. digest receives the SHA-256 of content.
+OutputStatus write_output_file(const char* path, const char* content, size_t length, const unsigned char* previous_digest, unsigned char* digest);
+
+// For pages not rendered from a single source (index, feeds): the cache record
+// is keyed by the output path itself. Must not be called from render threads.
+OutputStatus write_generated_output(const BuildCache* old_cache, HashTable* new_cache, const char* path, const char* content);
+
+// Copies a static file unless dest already has the same content.
+OutputStatus copy_output_file(const char* src_path, const char* dest_path);
+
+const char* output_status_name(OutputStatus status);
+
+// Every created, modified or deleted output of the current build is collected
+// (thread-safe) and written as <CACHE_DIR>/deploy_manifest.json and .ndjson,
+// so a deploy step can upload only the delta.
+bool remove_output_file(const char* path, const unsigned char* previous_digest);
+void write_deploy_manifest();
+void free_deploy_manifest();
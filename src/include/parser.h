@@ -1,6 +1,6 @@
 #pragma once
 
-#include "list_head.h"
+#include <stdint.h>
 #include "tokenizer.h"
 #include "site_context.h"
 
@@ -27,16 +27,60 @@ typedef enum {
 	NODE_SOFT_BREAK,
 } AstNodeType;
 
+// Bump whenever the Ast a given markdown text parses to changes, so cached
+// Asts from an older parser are not reused.
+#define PARSER_VERSION 4
+
+typedef uint32_t AstNodeId;
+
+#define AST_NONE UINT32_MAX
+
+// 20 bytes; the children of a node follow it in the array, linked by index.
 typedef struct {
-	struct list_head list;
-	struct list_head children;
-	
-	AstNodeType type;
-	char* data1; // main data: string data, code block, etc.
-	char* data2; // sub data: code lang, link, etc.
+	uint8_t type;           // AstNodeType
+	AstNodeId first_child;  // AST_NONE for a leaf
+	AstNodeId next_sibling; // AST_NONE for the last child
+	uint32_t data1;         // main data: string data, code block, etc.
+	uint32_t data2;         // sub data: code lang, link, etc.
 } AstNode;
 
+// A parsed document: nodes in pre-order, nodes[0] being the document node,
+// and one pool holding every NUL-terminated string the nodes refer to by
+// offset (AST_NONE when absent). Nothing points anywhere else, so the whole
+// tree is a few flat blocks.
+//
+// links lists the [[wikilink]] nodes in document order. Their data1 is the
+// link target; data2 stays AST_NONE until resolve_wikilinks, because the
+// URL depends on the site rather than on the markdown. resolve_wikilinks
+// also gives a link with a fragment its text, "Note > Heading".
+//
+// A paragraph, list item or blockquote ending in an Obsidian block id
+// (" ^id") has the id in data1, without its caret, and the marker is
+// removed from its text.
+typedef struct {
+	AstNode* nodes;
+	size_t node_count;
+	AstNodeId* links;
+	size_t link_count;
+	char* strings;
+	size_t strings_length;
+	size_t strings_capacity;
+} Ast;
+
+// Parses and resolves wikilinks, i.e. parse_document + resolve_wikilinks.
+Ast* parse_tokens(TokenStream* tokens, SiteContext* s_context);
+Ast* parse_document(TokenStream* tokens);
+void resolve_wikilinks(Ast* ast, SiteContext* s_context);
+void free_ast(Ast* ast);
+
+static inline const AstNode* ast_node(const Ast* ast, AstNodeId id) {
+	return id == AST_NONE ? NULL : &ast->nodes[id];
+}
 
-AstNode* parse_tokens(struct list_head* tokens, SiteContext* s_context, const char* current_file_path);
-void free_ast(AstNode* root);
+static inline const char* ast_data1(const Ast* ast, const AstNode* node) {
+	return node->data1 == AST_NONE ? NULL : ast->strings + node->data1;
+}
 
+static inline const char* ast_data2(const Ast* ast, const AstNode* node) {
+	return node->data2 == AST_NONE ? NULL : ast->strings + node->data2;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "hash_table.h"
+#include "file_utils.h"
+
+#define SCAN_SNAPSHOT_FILE "scan.snapshot"
+#define SCAN_SNAPSHOT_MAGIC "SSGSCAN\0"
+#define SCAN_SNAPSHOT_VERSION 1
+
+typedef struct {
+	char* name;
+	bool is_directory;
+} SnapshotEntry;
+
+// Listing of one directory, valid as long as the directory's stamp is unchanged.
+// Entries are kept in readdir order so a replayed scan builds the same tree.
+typedef struct {
+	FileStamp stamp;
+	SnapshotEntry* entries;
+	size_t count;
+	size_t capacity;
+} DirectorySnapshot;
+
+typedef struct {
+	HashTable* directories; // directory path -> DirectorySnapshot*
+	size_t directory_count;
+} ScanSnapshot;
+
+ScanSnapshot* create_scan_snapshot();
+ScanSnapshot* load_scan_snapshot();
+void save_scan_snapshot(const ScanSnapshot* snapshot);
+void free_scan_snapshot(ScanSnapshot* snapshot);
+
+const DirectorySnapshot* find_directory_snapshot(const ScanSnapshot* snapshot, const char* path, const FileStamp* stamp);
+DirectorySnapshot* add_directory_snapshot(ScanSnapshot* snapshot, const char* path, const FileStamp* stamp);
+void directory_snapshot_add_entry(DirectorySnapshot* directory, const char* name, bool is_directory);
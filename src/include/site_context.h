@@ -3,28 +3,52 @@
 #include "list_head.h"
 #include "hash_table.h"
 #include "template_engine.h"
+#include "source_document.h"
+#include "cache_manager.h"
+#include "scan_snapshot.h"
+#include "link_resolver.h"
 
 typedef struct NavNode {
 	char* name;
 	char* full_path;
 	char* output_path;
 	char* slug;
-	char* excerpt;
 	bool is_directory;
 
+	// markdown files only
+	NoteMetadata meta;
+	FileStamp stamp;
+	SourceDocument* source; // NULL until read, see load_note_source()
+	unsigned char source_digest[HASH_DIGEST_SIZE]; // kept by release_note_source()
+	bool has_source_digest;
+
+	// directories only, see compute_tree_digest()
+	unsigned char tree_digest[HASH_DIGEST_SIZE];
+
 	struct list_head children;
 	struct list_head sibling;
 } NavNode;
 
 typedef struct {
 	NavNode* root;
-	HashTable* fast_lookup_by_name;
 	HashTable* fast_lookup_by_path;
+	LinkResolver* link_resolver; // built once the whole vault is scanned
+	ScanSnapshot* snapshot; // directory listings seen by this scan, saved for the next one
 } SiteContext;
 
-SiteContext* create_site_context(const char* vault_path);
+SiteContext* create_site_context(const char* vault_path, const BuildCache* cache, const ScanSnapshot* previous);
 void free_site_context(SiteContext* context);
 
+SourceDocument* load_note_source(NavNode* node, const char* file_path);
+// Frees the note's text once nothing in the build needs it any more; its
+// digest stays on the node.
+void release_note_source(NavNode* node);
+
+NavNode* find_link_target(SiteContext* context, const char* link_target);
+const char* resolve_link_url(SiteContext* context, const char* link_target);
+// dependency_digest() of resolve_link_url(), without hashing it again.
+void resolve_link_digest(SiteContext* context, const char* link_target, unsigned char* digest);
+
 void generate_sidebar_html(SiteContext* s_context, TemplateContext* global_context);
 void generate_breadcrumb_html(NavNode* current_node, TemplateContext* local_context, SiteContext* s_context);
 
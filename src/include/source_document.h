@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "template_engine.h"
+#include "file_utils.h"
+#include "hash_utils.h"
+
+// Per-note values the scan needs before anything renders. Also kept in the
+// build cache, so unchanged notes do not have to be read to get them.
+typedef struct {
+	char* slug;     // front matter slug, NULL if absent
+	char* excerpt;
+	char* title;    // front matter title, NULL if absent
+	char* date;
+	char* aliases;  // front matter aliases, one per line, NULL if absent
+	int id;
+	int order;
+	bool has_order;
+} NoteMetadata;
+
+// Notes larger than this (chat logs, dumps) are not read whole: only their
+// first SOURCE_STREAM_CHUNK bytes are kept for the front matter and excerpt,
+// and the body is tokenized from the file SOURCE_STREAM_CHUNK bytes at a time.
+#define SOURCE_STREAM_THRESHOLD (8 * 1024 * 1024)
+#define SOURCE_STREAM_CHUNK (64 * 1024)
+
+// Everything the build needs from one markdown file, taken from a single read.
+typedef struct {
+	char* content;      // whole file, or its head when path is set; NUL-terminated
+	size_t length;
+	const char* body;   // markdown after the front matter block (points into content)
+	char* path;         // set when the body has to be streamed from the file
+	size_t body_offset; // file offset of body
+	unsigned char digest[HASH_DIGEST_SIZE]; // SHA-256 of content, see get_source_digest()
+	bool has_digest;
+	FileStamp stamp;
+
+	TemplateContext* front_matter;
+	NoteMetadata meta;
+} SourceDocument;
+
+SourceDocument* load_source_document(const char* file_path);
+const unsigned char* get_source_digest(SourceDocument* doc);
+void free_source_document(SourceDocument* doc);
+
+void copy_note_metadata(NoteMetadata* dest, const NoteMetadata* src);
+void free_note_metadata(NoteMetadata* meta);
@@ -1,6 +1,9 @@
 #pragma once
 
-#include "list_head.h"
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
 
 typedef enum {
 	TOKEN_HASH,        // #
@@ -23,12 +26,68 @@ typedef enum {
 	TOKEN_EOF,         // End of File
 } TokenType;
 
+// A token does not own its text: it is the span [offset, offset + length) of
+// the tokenized source, which has to outlive the token list.
+// Punctuation tokens span their single character, EOF is empty.
 typedef struct {
 	TokenType type;
-	char* value;
-	struct list_head list;
+	uint32_t line;  // 0-based line: NEWLINE tokens end lines (a fenced code body does not)
+	size_t offset;
+	size_t length;
 } Token;
 
-void tokenize_file(FILE* file, struct list_head* output);
-void tokenize_string(const char* content, struct list_head* output);
+// One entry per source line, recorded by the token stream as the line's
+// tokens are produced, so block parsing can read a line's shape in O(1).
+typedef struct {
+	size_t first_token;   // index of the line's first token
+	int indent;           // leading TAB tokens
+	TokenType first_type; // first token after the indent
+	bool blank;           // nothing but the indent before the newline (or EOF)
+} LineInfo;
+
+// Tokens of one source in a single contiguous array, ending with TOKEN_EOF.
+typedef struct {
+	const char* source;
+	Token* items;
+	size_t count;
+	size_t capacity;
+} TokenList;
+
+// Pull-based tokenizer: tokens are produced on demand as the parser asks for
+// them and kept in a ring of fixed-size chunks, so a Token* stays valid until
+// it is released. Indexes are absolute positions in the token sequence.
+typedef struct TokenStream TokenStream;
+
+TokenStream* create_token_stream(const char* source);
+// Reads the file chunk_size bytes at a time from its current position
+// instead of taking the whole text, see token_stream.c. Offsets count from
+// that position, and token text has to be read with token_stream_text().
+TokenStream* create_file_token_stream(FILE* file, size_t chunk_size);
+// The text of a retained token, valid until the stream produces more tokens.
+const char* token_stream_text(const TokenStream* stream, const Token* token);
+// Returns NULL past TOKEN_EOF.
+Token* token_stream_get(TokenStream* stream, size_t index);
+// Tokens before index will not be asked for again and may be discarded.
+void token_stream_release(TokenStream* stream, size_t index);
+// The line of the token at index. Its first token after the indent has been produced.
+const LineInfo* token_stream_line(TokenStream* stream, size_t index);
+// The most tokens the stream has held at once, in whole chunks.
+size_t token_stream_peak_window(const TokenStream* stream);
+void free_token_stream(TokenStream* stream);
+
+// Returns the file content the tokens point into; the caller frees it after the tokens.
+char* tokenize_file(FILE* file, TokenList* output);
+
+// Streaming mode for files too large to read at once: a file token stream
+// drained into the sink. Each token is handed over with its text, which is
+// only valid during the call. Memory is bounded by the window: chunk_size plus
+// the longest single token (a fenced code body is one token).
+typedef void (*TokenSink)(const Token* token, const char* text, void* context);
+
+void tokenize_file_chunked(FILE* file, size_t chunk_size, TokenSink sink, void* context);
+void tokenize_string(const char* content, TokenList* output);
+void free_tokens(TokenList* tokens);
 
+static inline const char* token_text(const char* source, const Token* token) {
+	return source + token->offset;
+}
@@ -5,6 +5,7 @@
 #include <dirent.h>
 #include <stdbool.h>
 #include <time.h>
+#include <unistd.h>
 
 #include "include/ignore_handler.h"
 #include "include/template_engine.h"
@@ -13,21 +14,40 @@
 #include "include/build_process.h"
 #include "include/file_utils.h"
 #include "include/cache_manager.h"
+#include "include/ast_cache.h"
+#include "include/scan_snapshot.h"
 #include "include/hash_table.h"
 #include "include/dynamic_buffer.h"
 #include "include/feed_generator.h"
+#include "include/output_writer.h"
 
 #define MAX_PATH_LENGTH 1024
 
-void generate_main_index_page(struct list_head* all_posts, TemplateContext* global_context);
-void generate_all_posts_page(struct list_head* all_posts, TemplateContext* global_context);
+void generate_main_index_page(struct list_head* all_posts, TemplateContext* global_context, const BuildCache* old_cache, HashTable* new_cache);
+void generate_all_posts_page(struct list_head* all_posts, TemplateContext* global_context, const BuildCache* old_cache, HashTable* new_cache);
 
 int main(int argc, char *argv[]) {
-	clock_t start_time = clock();
+	struct timespec start_time;
+	clock_gettime(CLOCK_MONOTONIC, &start_time);
 
 	const char* vault_path = ".";
-	if (argc > 1) {
-		vault_path = argv[1];
+	BuildOptions build_options = { .jobs = 1, .paranoid = false };
+
+	for (int i = 1; i < argc; i++) {
+		if ((strcmp(argv[i], "--jobs") == 0 || strcmp(argv[i], "-j") == 0) && i + 1 < argc) {
+			build_options.jobs = atoi(argv[++i]);
+		} else if (strncmp(argv[i], "--jobs=", 7) == 0) {
+			build_options.jobs = atoi(argv[i] + 7);
+		} else if (strcmp(argv[i], "--paranoid") == 0) {
+			build_options.paranoid = true;
+		} else {
+			vault_path = argv[i];
+		}
+	}
+
+	if (build_options.jobs <= 0) {
+		long online_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		build_options.jobs = online_cpus > 0 ? (int)online_cpus : 1;
 	}
 
 	const char* output_dir = "ssg_output";
@@ -37,6 +57,7 @@ int main(int argc, char *argv[]) {
 	printf("----- STARTING SSG BUILD -----\n");
 	printf("Vault Path: %s\n", vault_path);
 	printf("Output Dir: %s\n", output_dir);
+	printf("Jobs: %d\n", build_options.jobs);
 	printf("------------------------------\n\n");
 
 	printf("[STEP 1] Loading global context from config.json...\n");
@@ -55,15 +76,26 @@ int main(int argc, char *argv[]) {
 		fprintf(stderr, "Fatal: Failed to prepare cache directory. Aborting.\n");
 		return EXIT_FAILURE;
 	}
-	HashTable* old_cache = load_cache();
+	BuildCache* old_cache = load_cache();
 	HashTable* new_cache = ht_create(1024);
 	printf("Previous build cache loaded.\n");
 
-	printf("[STEP 4] Scanning vault and creating site context...\n");
-	SiteContext* site_context = create_site_context(vault_path);
-
-	printf("[STEP 5] Loading .ssgignore and preparing output directory...\n");
+	printf("[STEP 4] Loading .ssgignore...\n");
+	// the output and static directories may sit inside the vault, e.g. when
+	// the vault is the working directory; their files are not notes. The
+	// image directory stays linkable for ![[image]] embeds.
 	load_ssgignore(vault_path);
+	const char* configured_output_dir = get_from_context(global_context, "build.output_dir");
+	ignore_directory(vault_path, configured_output_dir ? configured_output_dir : output_dir);
+	ignore_directory(vault_path, loaded_static_dir);
+
+	printf("[STEP 5] Scanning vault and creating site context...\n");
+	// --paranoid lists every directory and re-reads every note instead of
+	// trusting the snapshot and cached metadata
+	ScanSnapshot* old_snapshot = build_options.paranoid ? NULL : load_scan_snapshot();
+	SiteContext* site_context = create_site_context(vault_path, build_options.paranoid ? NULL : old_cache, old_snapshot);
+	free_scan_snapshot(old_snapshot);
+	report_link_ambiguities(site_context->link_resolver);
 
 	printf("[STEP 6] Generating sidebar...\n");
 	generate_sidebar_html(site_context, global_context);
@@ -71,7 +103,7 @@ int main(int argc, char *argv[]) {
 	printf("[STEP 7] Preparing output directory...\n");
 	mkdir(output_dir, 0755);
 
-	build_site(vault_path, site_context, global_context, old_cache, new_cache, &all_posts);
+	build_site(vault_path, site_context, global_context, old_cache, new_cache, &all_posts, &build_options);
 
 	printf("[STEP 8] Copying static files...\n");
 	const char* static_dir = get_from_context(global_context, "build.static_dir");
@@ -93,31 +125,33 @@ int main(int argc, char *argv[]) {
 		printf("[INFO] 'build.image_dir' not found in config.json, skipping.\n");
 	}
 
-	printf("[STEP 10] Pruning stale files...\n");
-	for (size_t i = 0; i < old_cache->size; ++i) {
-		HashEntry* entry = old_cache->entries[i];
-		while (entry) {
-			if (ht_get(new_cache, entry->key) == NULL) {
-				char* value_str = (char*)entry->value;
-				char* delimiter = strrchr(value_str, ':');
-				if (delimiter) {
-					char* file_to_delete = delimiter + 1;
-					if (remove(file_to_delete) == 0) {
-						printf(" - Removed stale file: %s\n", file_to_delete);
-					}
-				}
+	printf("[STEP 10] Generating main index and all posts page...\n");
+	generate_main_index_page(&all_posts, global_context, old_cache, new_cache);
+	generate_all_posts_page(&all_posts, global_context, old_cache, new_cache);
+
+	printf("[STEP 11] Generating sitemap and RSS feed...\n");
+	generate_sitemap(site_context, &all_posts, global_context, old_cache, new_cache);
+	generate_rss_feed(&all_posts, global_context, old_cache, new_cache);
+
+	// after every output of this build is in new_cache
+	printf("[STEP 12] Pruning stale files...\n");
+	HashTable* live_outputs = ht_create(1024);
+	for (size_t i = 0; i < new_cache->size; ++i) {
+		for (HashEntry* entry = new_cache->entries[i]; entry; entry = entry->next) {
+			ht_set(live_outputs, ((CacheEntry*)entry->value)->output_path, entry->value);
+		}
+	}
+	for (size_t i = 0; i < old_cache->record_count; ++i) {
+		const CacheRecord* record = cache_record_at(old_cache, i);
+		const char* file_to_delete = cache_record_output_path(old_cache, record);
+		// a source may be gone while another one now writes the same output
+		if (ht_get(new_cache, cache_record_key(old_cache, record)) == NULL && ht_get(live_outputs, file_to_delete) == NULL) {
+			if (remove_output_file(file_to_delete, record->output_digest)) {
+				printf(" - Removed stale file: %s\n", file_to_delete);
 			}
-			entry = entry->next;
 		}
 	}
-
-	printf("[STEP 11] Generating main index and all posts page...\n");
-	generate_main_index_page(&all_posts, global_context);
-	generate_all_posts_page(&all_posts, global_context);
-
-	printf("[STEP 12] Generating sitemap and RSS feed...\n");
-	generate_sitemap(site_context, &all_posts, global_context);
-	generate_rss_feed(&all_posts, global_context);
+	ht_destroy(live_outputs, NULL);
 
 	printf("[STEP 13] Cleaning up and saving cache...\n");
 	PostSortInfo *post_info, *tmp;
@@ -127,14 +161,19 @@ int main(int argc, char *argv[]) {
 		free(post_info);
 	}
 	save_cache(new_cache);
-	ht_destroy(old_cache, free);
-	ht_destroy(new_cache, free);
+	prune_ast_cache(new_cache);
+	save_scan_snapshot(site_context->snapshot);
+	write_deploy_manifest();
+	free_deploy_manifest();
+	unload_cache(old_cache);
+	ht_destroy(new_cache, free_cache_entry);
 	free_site_context(site_context);
 	free_template_context(global_context);
 	free_ignore_patterns();
 
-	clock_t end_time = clock();
-	double time_spent = (double)(end_time - start_time) / CLOCKS_PER_SEC;
+	struct timespec end_time;
+	clock_gettime(CLOCK_MONOTONIC, &end_time);
+	double time_spent = (end_time.tv_sec - start_time.tv_sec) + (end_time.tv_nsec - start_time.tv_nsec) / 1e9;
 
 	printf("---- BUILD FINISHED SUCCESSFULLY! ----\n");
 	printf("Total build time: %.3f seconds\n", time_spent);
@@ -143,7 +182,7 @@ int main(int argc, char *argv[]) {
 	return EXIT_SUCCESS;
 }
 
-void generate_main_index_page(struct list_head* all_posts, TemplateContext* global_context) {
+void generate_main_index_page(struct list_head* all_posts, TemplateContext* global_context, const BuildCache* old_cache, HashTable* new_cache) {
 	int post_count = 0;
 	PostSortInfo* p;
 	list_for_each_entry(p, all_posts, list) { post_count++; }
@@ -171,7 +210,7 @@ void generate_main_index_page(struct list_head* all_posts, TemplateContext* glob
 		add_to_context(card_context, "post_title", title_from_name);
 		add_to_context(card_context, "post_link", link_path);
 
-		const char* preview_text = sort_array[i].node->excerpt ? sort_array[i].node->excerpt : "내용이 없습니다.";
+		const char* preview_text = sort_array[i].node->meta.excerpt ? sort_array[i].node->meta.excerpt : "내용이 없습니다.";
 		add_to_context(card_context, "post_excerpt", preview_text);
 
 		char* rendered_card = render_template("templates/components/simple_post_item.html", card_context);
@@ -206,11 +245,9 @@ void generate_main_index_page(struct list_head* all_posts, TemplateContext* glob
 	char output_path[MAX_PATH_LENGTH];
 	snprintf(output_path, sizeof(output_path), "%s/index.html", output_dir ? output_dir : "ssg_output");
 
-	FILE* out_file = fopen(output_path, "w");
-	if (out_file) {
-		fprintf(out_file, "%s", final_html);
-		fclose(out_file);
-		printf("  - Generated main index page: %s\n", output_path);
+	OutputStatus status = write_generated_output(old_cache, new_cache, output_path, final_html);
+	if (status != OUTPUT_FAILED) {
+		printf("  - Generated main index page (%s): %s\n", output_status_name(status), output_path);
 	}
 
 	free(sort_array);
@@ -221,7 +258,7 @@ void generate_main_index_page(struct list_head* all_posts, TemplateContext* glob
 
 }
 
-void generate_all_posts_page(struct list_head* all_posts, TemplateContext* global_context) {
+void generate_all_posts_page(struct list_head* all_posts, TemplateContext* global_context, const BuildCache* old_cache, HashTable* new_cache) {
 	int post_count = 0;
 	PostSortInfo* p;
 	list_for_each_entry(p, all_posts, list) { post_count++; }
@@ -248,7 +285,7 @@ void generate_all_posts_page(struct list_head* all_posts, TemplateContext* globa
 		add_to_context(card_context, "card_item_title", title_from_name);
 		add_to_context(card_context, "card_item_link", link_path);
 
-		const char* preview_text = sort_array[i].node->excerpt ? sort_array[i].node->excerpt : "내용이 없습니다.";
+		const char* preview_text = sort_array[i].node->meta.excerpt ? sort_array[i].node->meta.excerpt : "내용이 없습니다.";
 		add_to_context(card_context, "card_item_content", preview_text);
 
 		char* rendered_card = render_template("templates/components/card.html", card_context);
@@ -286,11 +323,9 @@ void generate_all_posts_page(struct list_head* all_posts, TemplateContext* globa
 	char output_path[MAX_PATH_LENGTH];
 	snprintf(output_path, sizeof(output_path), "%s/%s.html", output_dir ? output_dir : "ssg_output", posts_page_slug);
 
-	FILE* out_file = fopen(output_path, "w");
-	if (out_file) {
-		fprintf(out_file, "%s", final_html);
-		fclose(out_file);
-		printf("  - Generated all posts page: %s\n", output_path);
+	OutputStatus status = write_generated_output(old_cache, new_cache, output_path, final_html);
+	if (status != OUTPUT_FAILED) {
+		printf("  - Generated all posts page (%s): %s\n", output_status_name(status), output_path);
 	}
 
 	free(sort_array);
@@ -1,34 +1,31 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
 
 #include "block_parser.h"
 #include "inline_parser.h"
 #include "parser_utils.h"
-#include "../include/dynamic_buffer.h"
-
-static AstNode* parse_paragraph(ParserState* state);
-static AstNode* parse_heading(ParserState* state);
-static AstNode* parse_line(ParserState* state);
-static AstNode* parse_code_block(ParserState* state);
-static AstNode* parse_list(ParserState* state, int expected_indent);
-static AstNode* parse_list_item(ParserState* state, int item_indent);
-static AstNode* parse_blockquote(ParserState* state);
-
-AstNode* parse_block(ParserState* state) {
-	struct list_head* start_pos = state->current_node;
-	int indent = calculate_indent(state);
-
-	struct list_head* temp_node = state->current_node->next;
-	for (int i = 0; i < indent; ++i) {
-		if (temp_node != state->head) temp_node = temp_node->next;
-		else return parse_paragraph(state);
-	}
-
-	if (temp_node == state->head) return NULL;
-	Token* start_token = list_entry(temp_node, Token, list);
 
-	switch (start_token->type) {
+static ParseNode* parse_paragraph(ParserState* state);
+static ParseNode* parse_heading(ParserState* state);
+static ParseNode* parse_line(ParserState* state);
+static ParseNode* parse_code_block(ParserState* state);
+static ParseNode* parse_list(ParserState* state, int expected_indent);
+static ParseNode* parse_list_item(ParserState* state, int item_indent);
+static ParseNode* parse_blockquote(ParserState* state);
+static void take_block_id(ParseNode* block_node);
+
+ParseNode* parse_block(ParserState* state) {
+	size_t start_pos = state->position;
+	// blocks normally start a line, whose shape is in the line table
+	const LineInfo* line = line_at_cursor(state);
+	int indent = line ? line->indent : calculate_indent(state);
+
+	Token* start_token = peek_token_at(state, indent);
+	if (!start_token) return NULL;
+
+	switch (line ? line->first_type : start_token->type) {
 		case TOKEN_HASH:
 			consume_indent(state);
 			return parse_heading(state);
@@ -40,34 +37,28 @@ AstNode* parse_block(ParserState* state) {
 		case TOKEN_DASH:
 		case TOKEN_ASTERISK: {
 			consume_indent(state);
-			AstNode* line_node = parse_line(state);
+			ParseNode* line_node = parse_line(state);
 			if (line_node) return line_node;
 
-			state->current_node = start_pos;
+			state->position = start_pos;
 			if (calculate_indent(state) == indent) {
-				if (temp_node->next != state->head) {
-					Token* after_marker = list_entry(temp_node->next, Token, list);
-					if (after_marker->type == TOKEN_TEXT && after_marker->value && after_marker->value[0] == ' ') {
-						return parse_list(state, indent);
-					}
+				Token* after_marker = peek_token_at(state, indent + 1);
+				if (after_marker && after_marker->type == TOKEN_TEXT && token_starts_with(state, after_marker, ' ')) {
+					return parse_list(state, indent);
 				}
 			}
 			break;
 		}
 
 		case TOKEN_NUMBER: {
-			struct list_head* after_num_pos = temp_node->next;
-			if (after_num_pos == state->head) break;
-
-			Token* dot_token = list_entry(after_num_pos, Token, list);
+			Token* dot_token = peek_token_at(state, indent + 1);
+			if (!dot_token) break;
 
 			if (dot_token->type == TOKEN_DOT) {
-				struct list_head* after_dot_pos = after_num_pos->next;
-				if (after_dot_pos == state->head) break;
-
-				Token* text_token = list_entry(after_dot_pos, Token, list);
+				Token* text_token = peek_token_at(state, indent + 2);
+				if (!text_token) break;
 
-				if (text_token->type == TOKEN_TEXT && text_token->value && text_token->value[0] == ' ') {
+				if (text_token->type == TOKEN_TEXT && token_starts_with(state, text_token, ' ')) {
 					return parse_list(state, indent);
 				}
 			}
@@ -76,37 +67,39 @@ AstNode* parse_block(ParserState* state) {
 
 		case TOKEN_BACKTICK: {
 			consume_indent(state);
-			AstNode* code_node = parse_code_block(state);
+			ParseNode* code_node = parse_code_block(state);
 			if (code_node) return code_node;
-			state->current_node = start_pos;
+			state->position = start_pos;
 			break;
 		}
 		default:
 			break;
 	}
 
-	state->current_node = start_pos;
+	state->position = start_pos;
 	return parse_paragraph(state);
 }
 
-static AstNode* parse_paragraph(ParserState* state) {
-	AstNode* paragraph_node = create_ast_node(NODE_PARAGRAPH, NULL, NULL);
+static ParseNode* parse_paragraph(ParserState* state) {
+	ParseNode* paragraph_node = create_parse_node(state, NODE_PARAGRAPH, NULL, NULL);
 	parse_inline_elements(state, paragraph_node, false);
+	take_block_id(paragraph_node);
 	return paragraph_node;
 }
 
-static AstNode* parse_list_item(ParserState* state, int item_indent) {
-	AstNode* item_node = create_ast_node(NODE_LIST_ITEM, NULL, NULL);
+static ParseNode* parse_list_item(ParserState* state, int item_indent) {
+	ParseNode* item_node = create_parse_node(state, NODE_LIST_ITEM, NULL, NULL);
 	consume_token(state);
 	if (peek_token(state) && peek_token(state)->type == TOKEN_DOT) {
 		consume_token(state);
 	}
 	parse_inline_elements(state, item_node, true);
+	take_block_id(item_node);
 	match_token(state, TOKEN_NEWLINE);
 
 	int next_indent = calculate_indent(state);
 	if (next_indent > item_indent) {
-		AstNode* sub_list = parse_list(state, next_indent);
+		ParseNode* sub_list = parse_list(state, next_indent);
 		if (sub_list) {
 			add_child_node(item_node, sub_list);
 		}
@@ -114,38 +107,31 @@ static AstNode* parse_list_item(ParserState* state, int item_indent) {
 	return item_node;
 }
 
-static AstNode* parse_list(ParserState* state, int expected_indent) {
-	struct list_head* temp_pos = state->current_node->next;
-	for (int i = 0; i < expected_indent; i++) {
-		if (temp_pos == state->head) return NULL;
-		temp_pos = temp_pos->next;
-	}
-	if (temp_pos == state->head) return NULL;
-	Token* start_token = list_entry(temp_pos, Token, list);
+static ParseNode* parse_list(ParserState* state, int expected_indent) {
+	Token* start_token = peek_token_at(state, expected_indent);
+	if (!start_token) return NULL;
 
 	AstNodeType list_type = (start_token->type == TOKEN_DASH || start_token->type == TOKEN_ASTERISK)
 												? NODE_UNORDERED_LIST : NODE_ORDERED_LIST;
 
-	AstNode* list_node = create_ast_node(list_type, NULL, NULL);
+	ParseNode* list_node = create_parse_node(state, list_type, NULL, NULL);
 
 	while (peek_token(state)) {
-		int current_indent = calculate_indent(state);
+		// items start lines, so indent and marker come from the line table
+		const LineInfo* line = line_at_cursor(state);
+		int current_indent = line ? line->indent : calculate_indent(state);
 		if (current_indent != expected_indent) break;
 
-		struct list_head* marker_pos = state->current_node->next;
-		for (int i = 0; i < current_indent; i++) {
-			if (marker_pos == state->head) return list_node;
-			marker_pos = marker_pos->next;
-		}
-		if (marker_pos == state->head) return list_node;
-		Token* marker = list_entry(marker_pos, Token, list);
+		Token* marker = peek_token_at(state, current_indent);
+		if (!marker) return list_node;
+		TokenType marker_type = line ? line->first_type : marker->type;
 
-		bool type_match = (list_type == NODE_UNORDERED_LIST && (marker->type == TOKEN_DASH || marker->type == TOKEN_ASTERISK)) ||
-											(list_type == NODE_ORDERED_LIST && marker->type == TOKEN_NUMBER);
+		bool type_match = (list_type == NODE_UNORDERED_LIST && (marker_type == TOKEN_DASH || marker_type == TOKEN_ASTERISK)) ||
+											(list_type == NODE_ORDERED_LIST && marker_type == TOKEN_NUMBER);
 
 		if (type_match) {
 			consume_indent(state);
-			AstNode* item_node = parse_list_item(state, current_indent);
+			ParseNode* item_node = parse_list_item(state, current_indent);
 			add_child_node(list_node, item_node);
 		} else {
 			break;
@@ -154,41 +140,36 @@ static AstNode* parse_list(ParserState* state, int expected_indent) {
 	return list_node;
 }
 
-static AstNode* parse_heading(ParserState* state) {
+static ParseNode* parse_heading(ParserState* state) {
 	int level = 0;
-	struct list_head* start_pos = state->current_node;
+	size_t start_pos = state->position;
 	while (peek_token(state) && peek_token(state)->type == TOKEN_HASH) {
 		level++;
 		consume_token(state);
 	}
 	Token* first_text = peek_token(state);
-	if (!first_text || first_text->type != TOKEN_TEXT || !first_text->value || first_text->value[0] != ' ') {
-		state->current_node = start_pos;
+	if (!first_text || first_text->type != TOKEN_TEXT || !token_starts_with(state, first_text, ' ')) {
+		state->position = start_pos;
 		return NULL;
 	}
 
-	DynamicBuffer* buffer = create_dynamic_buffer(256);
-
+	// the heading text runs from after the space to the end of the line
+	size_t text_start = state->position;
 	consume_token(state);
-	if (strlen(first_text->value) > 1) {
-		buffer_append_formatted(buffer, "%s", first_text->value + 1);
-	}
 	while (peek_token(state) && peek_token(state)->type != TOKEN_NEWLINE) {
-		Token* current = consume_token(state);
-		buffer_append_formatted(buffer, "%s", token_to_string(current));
+		consume_token(state);
 	}
 
 	AstNodeType heading_type = (level == 1) ? NODE_HEADING1 : (level == 2) ? NODE_HEADING2 : NODE_HEADING3;
 
-	char* content_to_give = destroy_buffer_and_get_content(buffer);
-
-	AstNode* heading_node = create_ast_node(heading_type, content_to_give, NULL);
+	ParseNode* heading_node = create_parse_node(state, heading_type, NULL, NULL);
+	heading_node->data1 = copy_token_range(state, text_start, state->position) + 1;
 
 	return heading_node;
 }
 
-static AstNode* parse_line(ParserState* state) {
-	struct list_head* start_pos = state->current_node;
+static ParseNode* parse_line(ParserState* state) {
+	size_t start_pos = state->position;
 	Token* t1 = peek_token(state);
 	if (!t1 || (t1->type != TOKEN_DASH && t1->type != TOKEN_ASTERISK)) return NULL;
 
@@ -200,43 +181,46 @@ static AstNode* parse_line(ParserState* state) {
 	}
 	Token* final_token = peek_token(state);
 	if (count >= 3 && (final_token == NULL || final_token->type == TOKEN_NEWLINE || final_token->type == TOKEN_EOF)) {
-		return create_ast_node(NODE_LINE, NULL, NULL);
+		return create_parse_node(state, NODE_LINE, NULL, NULL);
 	}
-	state->current_node = start_pos;
+	state->position = start_pos;
 	return NULL;
 }
 
-static AstNode* parse_code_block(ParserState* state) {
-	struct list_head* start_pos = state->current_node;
+static ParseNode* parse_code_block(ParserState* state) {
+	size_t start_pos = state->position;
 	if (!(match_token(state, TOKEN_BACKTICK) && match_token(state, TOKEN_BACKTICK) && match_token(state, TOKEN_BACKTICK))) {
-		state->current_node = start_pos;
+		state->position = start_pos;
 		return NULL;
 	}
 
-	char* lang = NULL;
 	Token* lang_token = peek_token(state);
 	if (lang_token && lang_token->type == TOKEN_TEXT) {
-		lang = lang_token->value;
 		consume_token(state);
+	} else {
+		lang_token = NULL;
 	}
 	match_token(state, TOKEN_NEWLINE);
 
-	char* code_content = NULL;
 	Token* content_token = peek_token(state);
 	if (content_token && content_token->type == TOKEN_TEXT) {
-		code_content = content_token->value;
 		consume_token(state);
+	} else {
+		content_token = NULL;
 	}
 
 	if (!(match_token(state, TOKEN_BACKTICK) && match_token(state, TOKEN_BACKTICK) && match_token(state, TOKEN_BACKTICK))) {
-		state->current_node = start_pos;
+		state->position = start_pos;
 		return NULL;
 	}
-	return create_ast_node(NODE_CODE_BLOCK, code_content, lang);
+	ParseNode* node = create_parse_node(state, NODE_CODE_BLOCK, NULL, NULL);
+	if (content_token) node->data1 = copy_token_text(state, content_token);
+	if (lang_token) node->data2 = copy_token_text(state, lang_token);
+	return node;
 }
 
-static AstNode* parse_blockquote(ParserState* state) {
-	AstNode* blockquote_node = create_ast_node(NODE_BLOCKQUOTE, NULL, NULL);
+static ParseNode* parse_blockquote(ParserState* state) {
+	ParseNode* blockquote_node = create_parse_node(state, NODE_BLOCKQUOTE, NULL, NULL);
 
 	while (peek_token(state) && peek_token(state)->type == TOKEN_GREATER_THAN) {
 		consume_token(state);
@@ -247,7 +231,7 @@ static AstNode* parse_blockquote(ParserState* state) {
 			consume_token(state);
 
 			if (peek_token(state) && peek_token(state)->type == TOKEN_GREATER_THAN) {
-				AstNode* break_node = create_ast_node(NODE_SOFT_BREAK, NULL, NULL);
+				ParseNode* break_node = create_parse_node(state, NODE_SOFT_BREAK, NULL, NULL);
 				add_child_node(blockquote_node, break_node);
 			}
 		} else {
@@ -255,5 +239,32 @@ static AstNode* parse_blockquote(ParserState* state) {
 		}
 	}
 
+	take_block_id(blockquote_node);
 	return blockquote_node;
 }
+
+// An Obsidian block id, " ^id" at the end of a block, becomes the block's
+// data1 (the id without its caret) and leaves the text. Both point into the
+// same arena string.
+static void take_block_id(ParseNode* block_node) {
+	if (list_empty(&block_node->children)) return;
+	ParseNode* last = list_last_entry(&block_node->children, ParseNode, list);
+	// a paragraph at the end of the file keeps its final newline as a break
+	if (last->type == NODE_SOFT_BREAK && last->list.prev != &block_node->children) {
+		last = list_prev_entry(last, list);
+	}
+	if (last->type != NODE_TEXT || !last->data1) return;
+
+	char* text = last->data1;
+	char* caret = strrchr(text, '^');
+	if (!caret || caret == text || !isspace((unsigned char)caret[-1]) || !caret[1]) return;
+	for (const char* c = caret + 1; *c; c++) {
+		if (!isalnum((unsigned char)*c) && *c != '-') return;
+	}
+
+	char* end = caret;
+	while (end > text && isspace((unsigned char)end[-1])) end--;
+	*end = '\0';
+	block_node->data1 = caret + 1;
+	if (end == text) list_del(&last->list);
+}
@@ -3,6 +3,6 @@
 
 #include "parser_utils.h"
 
-AstNode* parse_block(ParserState* state);
+ParseNode* parse_block(ParserState* state);
 
 #endif
@@ -2,322 +2,279 @@
 #include <string.h>
 #include <stdbool.h>
 #include "inline_parser.h"
-#include "../include/dynamic_buffer.h"
 
 #define MAX_PATH_LENGTH 1024
 
-static AstNode* parse_emphasis(ParserState* state);
-static AstNode* parse_inline_code(ParserState* state);
-static AstNode* parse_standard_link(ParserState* state);
-static AstNode* parse_obsidian_link(ParserState* state, bool is_image);
-static AstNode* parse_math(ParserState* state);
+static ParseNode* parse_emphasis(ParserState* state);
+static ParseNode* parse_inline_code(ParserState* state);
+static ParseNode* parse_standard_link(ParserState* state);
+static ParseNode* parse_obsidian_link(ParserState* state, bool is_image);
+static ParseNode* parse_math(ParserState* state, bool is_list_item);
+
+// Closer searches. Each one scans forward from `from` and returns the index of
+// the closer, or NO_CLOSER when a stop token or the end comes first. Results
+// are memoised per kind: an opener that fails leaves a memo covering the
+// scanned range, so every later opener of that kind inside it is answered
+// without rescanning, and the whole inline pass stays linear.
+static bool recall_closer(ParserState* state, CloserKind kind, size_t from, size_t* found) {
+	CloserMemo* memo = &state->closers[kind];
+	if (!memo->valid || from < memo->from || from > memo->until) return false;
+	*found = memo->found;
+	return true;
+}
+
+static size_t remember_closer(ParserState* state, CloserKind kind, size_t from, size_t until, size_t found) {
+	state->closers[kind] = (CloserMemo){ .from = from, .until = until, .found = found, .valid = true };
+	return found;
+}
+
+static bool has_type(ParserState* state, size_t index, TokenType type) {
+	Token* token = token_at(state, index);
+	return token && token->type == type;
+}
+
+// The first run of at least `level` asterisks on the line closes emphasis,
+// using the last `level` of them.
+static size_t find_emphasis_closer(ParserState* state, int level, size_t from) {
+	CloserKind kind = CLOSER_ITALIC + level - 1;
+	size_t found;
+	if (recall_closer(state, kind, from, &found)) return found;
+
+	size_t i = from;
+	Token* token;
+	while ((token = token_at(state, i)) && token->type != TOKEN_NEWLINE && token->type != TOKEN_EOF) {
+		if (token->type != TOKEN_ASTERISK) {
+			i++;
+			continue;
+		}
+		size_t run = 1;
+		while (has_type(state, i + run, TOKEN_ASTERISK)) run++;
+		if (run >= (size_t)level) return remember_closer(state, kind, from, i, i + run - level);
+		i += run;
+	}
+	return remember_closer(state, kind, from, i, NO_CLOSER);
+}
+
+static size_t find_code_closer(ParserState* state, size_t from) {
+	size_t found;
+	if (recall_closer(state, CLOSER_CODE, from, &found)) return found;
+
+	size_t i = from;
+	Token* token;
+	while ((token = token_at(state, i)) && token->type != TOKEN_NEWLINE && token->type != TOKEN_EOF) {
+		if (token->type == TOKEN_BACKTICK) return remember_closer(state, CLOSER_CODE, from, i, i);
+		i++;
+	}
+	return remember_closer(state, CLOSER_CODE, from, i, NO_CLOSER);
+}
+
+// Math runs to the next `$` (or `$$`), across lines if need be, but not past
+// the end of the block: a blank line, or the line break of a list item.
+static size_t find_math_closer(ParserState* state, int level, size_t from, bool is_list_item) {
+	CloserKind kind = level == 1 ? CLOSER_MATH : CLOSER_DISPLAY_MATH;
+	size_t found;
+	if (recall_closer(state, kind, from, &found)) return found;
+
+	size_t i = from;
+	Token* token;
+	while ((token = token_at(state, i)) && token->type != TOKEN_EOF) {
+		if (token->type == TOKEN_NEWLINE && (is_list_item || has_type(state, i + 1, TOKEN_NEWLINE))) break;
+		if (token->type == TOKEN_DOLLAR && (level == 1 || has_type(state, i + 1, TOKEN_DOLLAR))) {
+			return remember_closer(state, kind, from, i, i);
+		}
+		i++;
+	}
+	return remember_closer(state, kind, from, i, NO_CLOSER);
+}
+
+// Link text ends at the first `]`; a line break before it means no link.
+static size_t find_link_text_closer(ParserState* state, size_t from) {
+	size_t found;
+	if (recall_closer(state, CLOSER_LINK_TEXT, from, &found)) return found;
+
+	size_t i = from;
+	Token* token;
+	while ((token = token_at(state, i)) && token->type != TOKEN_NEWLINE) {
+		if (token->type == TOKEN_RBRACKET) return remember_closer(state, CLOSER_LINK_TEXT, from, i, i);
+		i++;
+	}
+	return remember_closer(state, CLOSER_LINK_TEXT, from, i, NO_CLOSER);
+}
+
+// A link destination or a wikilink target does not span lines either.
+static size_t find_link_url_closer(ParserState* state, size_t from) {
+	size_t found;
+	if (recall_closer(state, CLOSER_LINK_URL, from, &found)) return found;
+
+	size_t i = from;
+	Token* token;
+	while ((token = token_at(state, i)) && token->type != TOKEN_NEWLINE && token->type != TOKEN_EOF) {
+		if (token->type == TOKEN_RPAREN) return remember_closer(state, CLOSER_LINK_URL, from, i, i);
+		i++;
+	}
+	return remember_closer(state, CLOSER_LINK_URL, from, i, NO_CLOSER);
+}
 
-void parse_inline_elements(ParserState* state, AstNode* parent_node, bool is_list_item) {
-	DynamicBuffer* text_buffer = create_dynamic_buffer(256);
+static size_t find_wikilink_closer(ParserState* state, size_t from) {
+	size_t found;
+	if (recall_closer(state, CLOSER_WIKILINK, from, &found)) return found;
+
+	size_t i = from;
+	Token* token;
+	while ((token = token_at(state, i)) && token->type != TOKEN_NEWLINE && token->type != TOKEN_EOF) {
+		if (token->type == TOKEN_RBRACKET && has_type(state, i + 1, TOKEN_RBRACKET)) {
+			return remember_closer(state, CLOSER_WIKILINK, from, i, i);
+		}
+		i++;
+	}
+	return remember_closer(state, CLOSER_WIKILINK, from, i, NO_CLOSER);
+}
+
+// Adds the plain text between `from` and the cursor, if there is any.
+static void flush_text(ParserState* state, ParseNode* parent_node, size_t from, size_t to) {
+	if (from >= to) return;
+	Token* first = token_at(state, from);
+	Token* last = token_at(state, to - 1);
+	if (last->offset + last->length == first->offset) return;
+
+	// a run of nothing but tabs adds no text
+	char* text = copy_token_range(state, from, to);
+	if (!*text) return;
+
+	ParseNode* node = create_parse_node(state, NODE_TEXT, NULL, NULL);
+	node->data1 = text;
+	add_child_node(parent_node, node);
+}
+
+void parse_inline_elements(ParserState* state, ParseNode* parent_node, bool is_list_item) {
+	size_t text_start = state->position;
 
 	while (peek_token(state) && peek_token(state)->type != TOKEN_EOF) {
 		Token* t1 = peek_token(state);
+		size_t element_start = state->position;
 
 		if (t1->type == TOKEN_NEWLINE) {
 			if (is_list_item) {
 				break;
 			} else {
-				Token* t2 = (t1->list.next != state->head) ? list_entry(t1->list.next, Token, list) : NULL;
+				Token* t2 = peek_token_at(state, 1);
 				if (t2 && t2->type == TOKEN_NEWLINE) {
 					break;
 				}
+				flush_text(state, parent_node, text_start, element_start);
 				consume_token(state);
+				text_start = state->position;
 
-				if (text_buffer->length > 0) {
-					add_child_node(parent_node, create_ast_node(NODE_TEXT, text_buffer->content, NULL));
-					text_buffer->length = 0;
-					text_buffer->content[0] = '\0';
-				}
-
-				add_child_node(parent_node, create_ast_node(NODE_SOFT_BREAK, NULL, NULL));
+				add_child_node(parent_node, create_parse_node(state, NODE_SOFT_BREAK, NULL, NULL));
 				continue;
 			}
 		}
 
-		AstNode* new_node = NULL;
+		ParseNode* new_node = NULL;
 		if (t1->type == TOKEN_ASTERISK) new_node = parse_emphasis(state);
 		else if (t1->type == TOKEN_BACKTICK) new_node = parse_inline_code(state);
-		else if (t1->type == TOKEN_DOLLAR) new_node = parse_math(state);
+		else if (t1->type == TOKEN_DOLLAR) new_node = parse_math(state, is_list_item);
 		else if (t1->type == TOKEN_EXCLAMATION) new_node = parse_obsidian_link(state, true);
 		else if (t1->type == TOKEN_LBRACKET) {
-			Token* lookahead = (t1->list.next != state->head) ? list_entry(t1->list.next, Token, list) : NULL;
+			Token* lookahead = peek_token_at(state, 1);
 			if (lookahead && lookahead->type == TOKEN_LBRACKET) new_node = parse_obsidian_link(state, false);
 			else new_node = parse_standard_link(state);
 		}
 
 		if (new_node) {
-			if (text_buffer->length > 0) {
-				add_child_node(parent_node, create_ast_node(NODE_TEXT, text_buffer->content, NULL));
-				text_buffer->length = 0;
-				text_buffer->content[0] = '\0';
-			}
+			flush_text(state, parent_node, text_start, element_start);
 			add_child_node(parent_node, new_node);
+			text_start = state->position;
 			continue;
 		}
 
-		Token* current_token = consume_token(state);
-		buffer_append_formatted(text_buffer, "%s", token_to_string(current_token));
-	}
-	if (text_buffer->length > 0) {
-		add_child_node(parent_node, create_ast_node(NODE_TEXT, text_buffer->content, NULL));
+		consume_token(state);
 	}
-	char* final_content = destroy_buffer_and_get_content(text_buffer);
-	free(final_content);
+	flush_text(state, parent_node, text_start, state->position);
 }
 
-static AstNode* parse_emphasis(ParserState* state) {
-	struct list_head* start_pos = state->current_node;
+// An asterisk run opens emphasis at its remaining length; runs longer than
+// three are left as text one asterisk at a time.
+static ParseNode* parse_emphasis(ParserState* state) {
 	int level = 0;
-
-	while (peek_token(state) && peek_token(state)->type == TOKEN_ASTERISK) {
+	while (level <= 3 && peek_token_at(state, level) && peek_token_at(state, level)->type == TOKEN_ASTERISK) {
 		level++;
-		consume_token(state);
-	}
-	if (level == 0 || level > 3) {
-		state->current_node = start_pos;
-		return NULL;
 	}
+	if (level == 0 || level > 3) return NULL;
 
-	DynamicBuffer* temp_buffer = create_dynamic_buffer(64);
-
-	while (peek_token(state)) {
-		Token* current = peek_token(state);
-
-		if (current->type == TOKEN_ASTERISK) {
-			int closing_level = 0;
-			struct list_head* temp_pos = state->current_node;
-
-			while(peek_token(state) && peek_token(state)->type == TOKEN_ASTERISK) {
-				closing_level++;
-				consume_token(state);
-			}
-
-			if (level == closing_level) {
-				AstNodeType type = (level == 1) ? NODE_ITALIC : (level == 2) ? NODE_BOLD : NODE_ITALIC_AND_BOLD;
-				AstNode* node = create_ast_node(type, temp_buffer->content, NULL);
-				char* temp_content = destroy_buffer_and_get_content(temp_buffer);
-				free(temp_content);
-				return node;
-			}
-
-			state->current_node = temp_pos;
-		}
-		Token* token_to_add = consume_token(state);
-		if (!token_to_add || token_to_add->type == TOKEN_NEWLINE || token_to_add->type == TOKEN_EOF) {
-			break;
-		}
-		buffer_append_formatted(temp_buffer, "%s", token_to_string(token_to_add));
-
-	}
+	size_t content_start = state->position + level;
+	size_t closer = find_emphasis_closer(state, level, content_start);
+	if (closer == NO_CLOSER) return NULL;
 
-	char* temp_content = destroy_buffer_and_get_content(temp_buffer);
-	free(temp_content);
-	state->current_node = start_pos;
-	return NULL;
+	AstNodeType type = (level == 1) ? NODE_ITALIC : (level == 2) ? NODE_BOLD : NODE_ITALIC_AND_BOLD;
+	ParseNode* node = create_parse_node(state, type, NULL, NULL);
+	node->data1 = copy_token_range(state, content_start, closer);
+	state->position = closer + level;
+	return node;
 }
 
-static AstNode* parse_inline_code(ParserState* state) {
-	struct list_head* start_pos = state->current_node;
-
-	if (!match_token(state, TOKEN_BACKTICK)) return NULL;
+static ParseNode* parse_inline_code(ParserState* state) {
+	if (!peek_token(state) || peek_token(state)->type != TOKEN_BACKTICK) return NULL;
 
-	DynamicBuffer* temp_buffer = create_dynamic_buffer(64);
-
-	while (peek_token(state)) {
-		Token* current = peek_token(state);
-
-		if (current->type == TOKEN_BACKTICK) {
-			consume_token(state);
-			AstNode* node = create_ast_node(NODE_CODE, temp_buffer->content, NULL);
-			char* temp_content = destroy_buffer_and_get_content(temp_buffer);
-			free(temp_content);
-			return node;
-		}
+	size_t content_start = state->position + 1;
+	size_t closer = find_code_closer(state, content_start);
+	if (closer == NO_CLOSER) return NULL;
 
-		if (current->type == TOKEN_NEWLINE || current->type == TOKEN_EOF) {
-			break;
-		}
-
-		Token* token_to_add = consume_token(state);
-		buffer_append_formatted(temp_buffer, "%s", token_to_string(token_to_add));
-	}
-
-	char* temp_content = destroy_buffer_and_get_content(temp_buffer);
-	free(temp_content);
-	state->current_node = start_pos;
-	return NULL;
+	ParseNode* node = create_parse_node(state, NODE_CODE, NULL, NULL);
+	node->data1 = copy_token_range(state, content_start, closer);
+	state->position = closer + 1;
+	return node;
 }
 
-static AstNode* parse_standard_link(ParserState* state) {
-	struct list_head* start_pos = state->current_node;
-	if (!match_token(state, TOKEN_LBRACKET)) return NULL;
-
-	DynamicBuffer* text_buffer = create_dynamic_buffer(128);
-
-	while (peek_token(state) && peek_token(state)->type != TOKEN_RBRACKET) {
-		Token* current = consume_token(state);
-		if (current->type == TOKEN_NEWLINE) {
-			destroy_buffer_and_get_content(text_buffer);
-			state->current_node = start_pos;
-			return NULL;
-		}
-		buffer_append_formatted(text_buffer, "%s", token_to_string(current));
-	}
+static ParseNode* parse_standard_link(ParserState* state) {
+	if (!peek_token(state) || peek_token(state)->type != TOKEN_LBRACKET) return NULL;
 
-	if (match_token(state, TOKEN_RBRACKET) && match_token(state, TOKEN_LPAREN)) {
-		DynamicBuffer* url_buffer = create_dynamic_buffer(256);
-
-		while(peek_token(state) && peek_token(state)->type != TOKEN_RPAREN) {
-			Token* current = consume_token(state);
-			buffer_append_formatted(url_buffer, "%s", token_to_string(current));
-		}
+	size_t text_start = state->position + 1;
+	size_t text_end = find_link_text_closer(state, text_start);
+	if (text_end == NO_CLOSER || !has_type(state, text_end + 1, TOKEN_LPAREN)) return NULL;
 
-		if (match_token(state, TOKEN_RPAREN)) {
-			AstNode* link_node = create_ast_node(NODE_LINK, text_buffer->content, url_buffer->content);
+	size_t url_start = text_end + 2;
+	size_t url_end = find_link_url_closer(state, url_start);
+	if (url_end == NO_CLOSER) return NULL;
 
-			destroy_buffer_and_get_content(text_buffer);
-			destroy_buffer_and_get_content(url_buffer);
-
-			return link_node;
-		}
-		destroy_buffer_and_get_content(url_buffer);
-	}
-
-	destroy_buffer_and_get_content(text_buffer);
-	state->current_node = start_pos;
-	return NULL;
-}
-
-static char* calculate_relative_path(const char* from_path, const char* to_path) {
-	if (!from_path || !to_path) return strdup("#");
-
-	char* relative_path = malloc(strlen(to_path) + 2);
-	if (relative_path) {
-		sprintf(relative_path, "/%s", to_path);
-	}
-	return relative_path;
+	ParseNode* link_node = create_parse_node(state, NODE_LINK, NULL, NULL);
+	link_node->data1 = copy_token_range(state, text_start, text_end);
+	link_node->data2 = copy_token_range(state, url_start, url_end);
+	state->position = url_end + 1;
+	return link_node;
 }
 
-static AstNode* parse_obsidian_link(ParserState* state, bool is_image) {
-	struct list_head* start_pos = state->current_node;
-	if (is_image) {
-		if (!match_token(state, TOKEN_EXCLAMATION)) return NULL;
-	}
-	if (!match_token(state, TOKEN_LBRACKET)) { state->current_node = start_pos; return NULL; }
-	if (!match_token(state, TOKEN_LBRACKET)) { state->current_node = start_pos; return NULL; }
-
-	DynamicBuffer* filename_buffer = create_dynamic_buffer(256);
-
-	while(peek_token(state)) {
-		Token* t1 = peek_token(state);
-		if (t1->list.next != state->head) {
-			Token* t2 = list_entry(t1->list.next, Token, list);
-			if (t1->type == TOKEN_RBRACKET && t2 && t2->type == TOKEN_RBRACKET) break;
-		} else {
-			break;
-		}
-		Token* current = consume_token(state);
-		buffer_append_formatted(filename_buffer, "%s", token_to_string(current));
-	}
-
-	if (match_token(state, TOKEN_RBRACKET) && match_token(state, TOKEN_RBRACKET)) {
-		AstNode* link_node = NULL;
-		char* link_text = strdup(filename_buffer->content);
-		char* link_target = filename_buffer->content;
-		NavNode* target_node = NULL;
-
-		target_node = (NavNode*)ht_get(state->s_context->fast_lookup_by_path, link_target);
+static ParseNode* parse_obsidian_link(ParserState* state, bool is_image) {
+	size_t name_start = state->position + (is_image ? 1 : 0);
+	if (is_image && !has_type(state, state->position, TOKEN_EXCLAMATION)) return NULL;
+	if (!has_type(state, name_start, TOKEN_LBRACKET) || !has_type(state, name_start + 1, TOKEN_LBRACKET)) return NULL;
+	name_start += 2;
 
-		if (!target_node) {
-			target_node = (NavNode*)ht_get(state->s_context->fast_lookup_by_name, link_target);
-		}
-
-		if (!target_node) {
-			char lookup_key_with_ext[MAX_PATH_LENGTH];
-			snprintf(lookup_key_with_ext, sizeof(lookup_key_with_ext), "%s.md", link_target);
-			target_node = (NavNode*)ht_get(state->s_context->fast_lookup_by_name, lookup_key_with_ext);
-		}
-
-		if (target_node) {
-			char* relative_path;
-			const char* target_name = target_node->name;
-			size_t name_len = strlen(target_name);
-
-			if (name_len > 3 && strcmp(target_name + name_len - 3, ".md") == 0) {
-				relative_path = malloc(strlen(target_node->slug) + 7);
-				sprintf(relative_path, "/%s", target_node->slug);
-			} else {
-				relative_path = malloc(strlen(target_node->output_path) + 2);
-				sprintf(relative_path, "/%s", target_node->output_path);
-			}
+	size_t name_end = find_wikilink_closer(state, name_start);
+	if (name_end == NO_CLOSER) return NULL;
 
-			link_node = create_ast_node(
-					is_image ? NODE_IMAGE_LINK : NODE_LINK,
-					link_text,
-					relative_path
-					);
-			free(relative_path);
-		} else {
-			fprintf(stderr, "Warning: Link target not found for '[[%s]]'\n", link_target);
-			link_node = create_ast_node(NODE_LINK, link_text, "#");
-		}
+	// the target is resolved against the site after parsing, see resolve_wikilinks
+	ParseNode* link_node = create_parse_node(state, is_image ? NODE_IMAGE_LINK : NODE_LINK, NULL, NULL);
+	link_node->data1 = copy_token_range(state, name_start, name_end);
+	link_node->is_wikilink = true;
 
-		destroy_buffer_and_get_content(filename_buffer);
-		free(link_text);
-		return link_node;
-	}
-	destroy_buffer_and_get_content(filename_buffer);
-	state->current_node = start_pos;
-	return NULL;
+	state->position = name_end + 2;
+	return link_node;
 }
 
-static AstNode* parse_math(ParserState* state) {
-	struct list_head* start_pos = state->current_node;
+static ParseNode* parse_math(ParserState* state, bool is_list_item) {
 	int level = 0;
-
-	while (peek_token(state) && peek_token(state)->type == TOKEN_DOLLAR) {
+	while (level < 2 && peek_token_at(state, level) && peek_token_at(state, level)->type == TOKEN_DOLLAR) {
 		level++;
-		consume_token(state);
-		if (level == 2) break;
 	}
-
 	if (level == 0) return NULL;
 
-	DynamicBuffer* temp_buffer = create_dynamic_buffer(64);
-
-	for (int i = 0; i < level; i++) {
-		buffer_append_formatted(temp_buffer, "$");
-	}
-
-	int closing_level = 0;
-	while (peek_token(state) && peek_token(state)->type != TOKEN_EOF) {
-		Token* current = peek_token(state);
-
-		if (current->type == TOKEN_DOLLAR) {
-			closing_level++;
-			consume_token(state);
-			buffer_append_formatted(temp_buffer, "$");
-
-			if (closing_level == level) {
-				AstNode* node = create_ast_node(NODE_MATH, temp_buffer->content, NULL);
-				char* temp_content = destroy_buffer_and_get_content(temp_buffer);
-				free(temp_content);
-				return node;
-			}
-		} else {
-			closing_level = 0;
-			Token* token_to_add = consume_token(state);
-			buffer_append_formatted(temp_buffer, "%s", token_to_string(token_to_add));
-		}
-	}
+	size_t closer = find_math_closer(state, level, state->position + level, is_list_item);
+	if (closer == NO_CLOSER) return NULL;
 
-	char* temp_content = destroy_buffer_and_get_content(temp_buffer);
-	free(temp_content);
-	state->current_node = start_pos;
-	return NULL;
+	// The delimiters stay part of the math text.
+	ParseNode* node = create_parse_node(state, NODE_MATH, NULL, NULL);
+	node->data1 = copy_token_range(state, state->position, closer + level);
+	state->position = closer + level;
+	return node;
 }
@@ -3,6 +3,6 @@
 
 #include "parser_utils.h"
 
-void parse_inline_elements(ParserState* state, AstNode* parent_node, bool is_list_item);
+void parse_inline_elements(ParserState* state, ParseNode* parent_node, bool is_list_item);
 
 #endif
@@ -1,18 +1,133 @@
+#include <stdio.h>
 #include <stdlib.h>
 #include <stddef.h>
+#include <string.h>
+#include <pthread.h>
 #include "parser_utils.h"
 #include "block_parser.h"
+#include "../include/dependency_tracker.h"
 
-AstNode* parse_tokens(struct list_head* token_head, SiteContext* s_context, const char* current_file_path) {
+#define AST_ARENA_CHUNK_SIZE (64 * 1024)
+
+// The parse tree is scratch: it lives in an arena until it is flattened.
+// One arena per thread is parked between documents and reused by the next
+// parse, so most pages allocate nothing new for it.
+static pthread_key_t spare_arena_key;
+static pthread_once_t spare_arena_once = PTHREAD_ONCE_INIT;
+
+static void free_spare_arena(void* arena) {
+	arena_free(arena);
+}
+
+static void create_spare_arena_key(void) {
+	pthread_key_create(&spare_arena_key, free_spare_arena);
+}
+
+static Arena* take_arena(void) {
+	pthread_once(&spare_arena_once, create_spare_arena_key);
+	Arena* arena = pthread_getspecific(spare_arena_key);
+	if (arena) {
+		pthread_setspecific(spare_arena_key, NULL);
+		return arena;
+	}
+	return arena_create(AST_ARENA_CHUNK_SIZE);
+}
+
+static void give_back_arena(Arena* arena) {
+	arena_reset(arena);
+	if (pthread_getspecific(spare_arena_key)) {
+		arena_free(arena);
+	} else {
+		pthread_setspecific(spare_arena_key, arena);
+	}
+}
+
+// Flattening sizes the Ast exactly first, then copies the tree into it in
+// pre-order.
+static void measure_parse_tree(const ParseNode* node, size_t* node_count, size_t* link_count, size_t* strings_length) {
+	(*node_count)++;
+	if (node->is_wikilink) (*link_count)++;
+	if (node->data1) *strings_length += strlen(node->data1) + 1;
+	if (node->data2) *strings_length += strlen(node->data2) + 1;
+
+	ParseNode* child;
+	list_for_each_entry(child, &node->children, list) {
+		measure_parse_tree(child, node_count, link_count, strings_length);
+	}
+}
+
+static uint32_t pool_string(Ast* ast, const char* text) {
+	if (!text) return AST_NONE;
+	size_t length = strlen(text) + 1;
+	uint32_t offset = (uint32_t)ast->strings_length;
+	memcpy(ast->strings + offset, text, length);
+	ast->strings_length += length;
+	return offset;
+}
+
+static AstNodeId flatten_parse_tree(Ast* ast, const ParseNode* node) {
+	AstNodeId id = (AstNodeId)ast->node_count++;
+	AstNode* flat = &ast->nodes[id];
+	flat->type = (uint8_t)node->type;
+	flat->first_child = AST_NONE;
+	flat->next_sibling = AST_NONE;
+	flat->data1 = pool_string(ast, node->data1);
+	flat->data2 = pool_string(ast, node->data2);
+	if (node->is_wikilink) ast->links[ast->link_count++] = id;
+
+	AstNodeId previous = AST_NONE;
+	ParseNode* child;
+	list_for_each_entry(child, &node->children, list) {
+		AstNodeId child_id = flatten_parse_tree(ast, child);
+		if (previous == AST_NONE) {
+			ast->nodes[id].first_child = child_id;
+		} else {
+			ast->nodes[previous].next_sibling = child_id;
+		}
+		previous = child_id;
+	}
+	return id;
+}
+
+static Ast* flatten_document(const ParseNode* document) {
+	size_t node_count = 0;
+	size_t link_count = 0;
+	size_t strings_length = 0;
+	measure_parse_tree(document, &node_count, &link_count, &strings_length);
+
+	Ast* ast = malloc(sizeof(Ast));
+	if (!ast) {
+		perror("Failed to allocate Ast");
+		exit(EXIT_FAILURE);
+	}
+	ast->nodes = malloc(node_count * sizeof(AstNode));
+	ast->links = malloc(link_count > 0 ? link_count * sizeof(AstNodeId) : 1);
+	ast->strings_capacity = strings_length > 0 ? strings_length : 1;
+	ast->strings = malloc(ast->strings_capacity);
+	if (!ast->nodes || !ast->links || !ast->strings) {
+		perror("Failed to allocate Ast");
+		exit(EXIT_FAILURE);
+	}
+	ast->node_count = 0;
+	ast->link_count = 0;
+	ast->strings_length = 0;
+	flatten_parse_tree(ast, document);
+	return ast;
+}
+
+Ast* parse_document(TokenStream* tokens) {
 	ParserState p_state;
-	p_state.head = token_head;
-	p_state.current_node = token_head;
-	p_state.s_context = s_context;
-	p_state.current_file_path = current_file_path;
+	p_state.tokens = tokens;
+	p_state.position = 0;
+	memset(p_state.closers, 0, sizeof(p_state.closers));
+
+	p_state.arena = take_arena();
 
-	AstNode* doc_node = create_ast_node(NODE_DOCUMENT, NULL, NULL);
+	ParseNode* doc_node = create_parse_node(&p_state, NODE_DOCUMENT, NULL, NULL);
 
 	while (peek_token(&p_state)) {
+		// blocks never backtrack past their own start
+		token_stream_release(tokens, p_state.position);
 		if (peek_token(&p_state)->type == TOKEN_NEWLINE) {
 			consume_token(&p_state);
 			continue;
@@ -21,12 +136,11 @@ AstNode* parse_tokens(struct list_head* token_head, SiteContext* s_context, cons
 			break;
 		}
 
-		AstNode* block = parse_block(&p_state);
+		ParseNode* block = parse_block(&p_state);
 		if (block) {
+			// an empty list is dropped; the arena reclaims it
 			bool is_empty_list = (block->type == NODE_ORDERED_LIST || block->type == NODE_UNORDERED_LIST) && list_empty(&block->children);
-			if (is_empty_list) {
-				free_ast(block);
-			} else {
+			if (!is_empty_list) {
 				add_child_node(doc_node, block);
 			}
 		} else {
@@ -35,18 +149,92 @@ AstNode* parse_tokens(struct list_head* token_head, SiteContext* s_context, cons
 			}
 		}
 	}
-	return doc_node;
+
+	Ast* ast = flatten_document(doc_node);
+	give_back_arena(p_state.arena);
+	return ast;
 }
 
-void free_ast(AstNode* root) {
-	if (!root) return;
-	struct list_head *pos, *q;
-	AstNode *entry;
-	list_for_each_safe(pos, q, &root->children) {
-		entry = list_entry(pos, AstNode, list);
-		free_ast(entry);
+static uint32_t append_pool_string(Ast* ast, const char* text) {
+	size_t length = strlen(text) + 1;
+	if (ast->strings_length + length > ast->strings_capacity) {
+		while (ast->strings_length + length > ast->strings_capacity) {
+			ast->strings_capacity *= 2;
+		}
+		ast->strings = realloc(ast->strings, ast->strings_capacity);
+		if (!ast->strings) {
+			perror("Failed to grow Ast strings");
+			exit(EXIT_FAILURE);
+		}
+	}
+	return pool_string(ast, text);
+}
+
+// The text of [[Note#Heading]] as Obsidian shows it: "Note > Heading",
+// one " > " per '#', and just the heading for [[#Heading]].
+static char* wikilink_label(const char* link_target) {
+	const char* fragment = find_link_fragment(link_target);
+	char* label = malloc(3 * strlen(link_target) + 1);
+	size_t length = fragment - link_target;
+	memcpy(label, link_target, length);
+
+	// each '#'-separated segment; "^blk" stays a segment of its own
+	for (const char* segment = fragment; *segment; ) {
+		if (*segment == '#') segment++;
+		size_t segment_length = strcspn(segment, "#");
+		if (segment_length > 0) {
+			if (length > 0) {
+				memcpy(label + length, " > ", 3);
+				length += 3;
+			}
+			memcpy(label + length, segment, segment_length);
+			length += segment_length;
+		}
+		segment += segment_length;
 	}
-	if(root->data1) free(root->data1);
-	if(root->data2) free(root->data2);
-	free(root);
+	label[length] = '\0';
+	return label;
+}
+
+// Fills in the URL of every wikilink. A target that is not in the site
+// becomes a plain link to "#", images included.
+void resolve_wikilinks(Ast* ast, SiteContext* s_context) {
+	for (size_t i = 0; i < ast->link_count; i++) {
+		AstNode* node = &ast->nodes[ast->links[i]];
+		// appending may move the pool, so nothing keeps a pointer into it
+		const char* link_target = ast->strings + node->data1;
+		const char* relative_path = s_context ? resolve_link_url(s_context, link_target) : NULL;
+		record_link_dependency(link_target, relative_path);
+		char* label = node->type == NODE_LINK && find_link_fragment(link_target) ? wikilink_label(link_target) : NULL;
+
+		if (relative_path) {
+			// resolve_link_url falls back to the note's own URL
+			if (find_link_fragment(link_target) && relative_path == resolve_link_target(s_context->link_resolver, link_target)->url) {
+				fprintf(stderr, "Warning: Heading or block not found for '[[%s]]', linking the note\n", link_target);
+			}
+			node->data2 = append_pool_string(ast, relative_path);
+		} else {
+			fprintf(stderr, "Warning: Link target not found for '[[%s]]'\n", link_target);
+			node->type = NODE_LINK;
+			node->data2 = append_pool_string(ast, "#");
+		}
+		if (label) {
+			node->data1 = append_pool_string(ast, label);
+			free(label);
+		}
+	}
+}
+
+Ast* parse_tokens(TokenStream* tokens, SiteContext* s_context) {
+	Ast* ast = parse_document(tokens);
+	resolve_wikilinks(ast, s_context);
+	return ast;
+}
+
+void free_ast(Ast* ast) {
+	if (!ast) return;
+	free(ast->nodes);
+	free(ast->links);
+	free(ast->strings);
+	free(ast);
 }
@@ -3,35 +3,41 @@
 #include <string.h>
 #include "parser_utils.h"
 
-AstNode* create_ast_node(AstNodeType type, const char* data1, const char* data2) {
-	AstNode* node = (AstNode*)malloc(sizeof(AstNode));
-	if (!node) {
-		perror("Failed to allocate AstNode");
-		exit(EXIT_FAILURE);
-	}
+ParseNode* create_parse_node(ParserState* state, AstNodeType type, const char* data1, const char* data2) {
+	ParseNode* node = arena_alloc(state->arena, sizeof(ParseNode));
 	node->type = type;
-	node->data1 = data1 ? strdup(data1) : NULL;
-	node->data2 = data2 ? strdup(data2) : NULL;
+	node->data1 = data1 ? arena_strdup(state->arena, data1) : NULL;
+	node->data2 = data2 ? arena_strdup(state->arena, data2) : NULL;
+	node->is_wikilink = false;
 	INIT_LIST_HEAD(&node->list);
 	INIT_LIST_HEAD(&node->children);
 	return node;
 }
 
-void add_child_node(AstNode* parent, AstNode* child) {
+void add_child_node(ParseNode* parent, ParseNode* child) {
 	if (parent && child) {
 		list_add_tail(&child->list, &parent->children);
 	}
 }
 
+Token* token_at(ParserState* state, size_t index) {
+	return token_stream_get(state->tokens, index);
+}
+
 Token* peek_token(ParserState* state) {
-	if (!state || !state->current_node || state->current_node->next == state->head) return NULL;
-	return list_entry(state->current_node->next, Token, list);
+	return peek_token_at(state, 0);
+}
+
+// The token `ahead` positions after the next one, NULL past the end.
+Token* peek_token_at(ParserState* state, size_t ahead) {
+	if (!state) return NULL;
+	return token_stream_get(state->tokens, state->position + ahead);
 }
 
 Token* consume_token(ParserState* state) {
-	if (!state || !state->current_node || state->current_node->next == state->head) return NULL;
-	state->current_node = state->current_node->next;
-	return list_entry(state->current_node, Token, list);
+	Token* token = peek_token(state);
+	if (token) state->position++;
+	return token;
 }
 
 bool match_token(ParserState* state, TokenType type) {
@@ -43,17 +49,20 @@ bool match_token(ParserState* state, TokenType type) {
 	return false;
 }
 
+// The line table entry when the next token starts a line, NULL mid-line.
+const LineInfo* line_at_cursor(ParserState* state) {
+	const LineInfo* line = token_stream_line(state->tokens, state->position);
+	return line && line->first_token == state->position ? line : NULL;
+}
+
 int calculate_indent(ParserState* state) {
+	const LineInfo* line = line_at_cursor(state);
+	if (line) return line->indent;
+
 	int indent = 0;
-	struct list_head* temp_node = state->current_node->next;
-	while (temp_node != state->head) {
-		Token* token = list_entry(temp_node, Token, list);
-		if (token->type == TOKEN_TAB) {
-			indent++;
-			temp_node = temp_node->next;
-		} else {
-			break;
-		}
+	Token* token;
+	while ((token = peek_token_at(state, indent)) && token->type == TOKEN_TAB) {
+		indent++;
 	}
 	return indent;
 }
@@ -64,18 +73,36 @@ void consume_indent(ParserState* state) {
 	}
 }
 
-const char* token_to_string(const Token* token) {
-	if (!token) return "";
-	if (token->value) return token->value;
-	switch (token->type) {
-		case TOKEN_DOT: return "."; case TOKEN_HASH: return "#";
-		case TOKEN_ASTERISK: return "*"; case TOKEN_DASH: return "-";
-		case TOKEN_LPAREN: return "("; case TOKEN_RPAREN: return ")";
-		case TOKEN_LBRACKET: return "["; case TOKEN_RBRACKET: return "]";
-		case TOKEN_BACKTICK: return "`"; case TOKEN_EXCLAMATION: return "!";
-		case TOKEN_GREATER_THAN: return ">"; case TOKEN_BACKSLASH: return "\\";
-		case TOKEN_DOLLAR: return "$";
-		default: return "";
+void append_token_text(DynamicBuffer* buffer, const ParserState* state, const Token* token) {
+	if (token) buffer_append_bytes(buffer, token_stream_text(state->tokens, token), token->length);
+}
+
+char* copy_token_text(ParserState* state, const Token* token) {
+	return arena_strndup(state->arena, token_stream_text(state->tokens, token), token->length);
+}
+
+// The text of tokens [from, to) without its newline and tab tokens, which
+// node text has never contained. Tokens are contiguous spans, so this is one
+// copy of the source, compacted only when such a token is in it.
+char* copy_token_range(ParserState* state, size_t from, size_t to) {
+	if (from >= to) return arena_strdup(state->arena, "");
+	Token* first = token_at(state, from);
+	Token* last = token_at(state, to - 1);
+	size_t span_length = last->offset + last->length - first->offset;
+	char* text = arena_strndup(state->arena, token_stream_text(state->tokens, first), span_length);
+	if (!memchr(text, '\n', span_length) && !memchr(text, '\t', span_length)) return text;
+
+	size_t length = 0;
+	for (size_t i = from; i < to; i++) {
+		Token* token = token_at(state, i);
+		if (token->type == TOKEN_NEWLINE || token->type == TOKEN_TAB) continue;
+		memmove(text + length, text + (token->offset - first->offset), token->length);
+		length += token->length;
 	}
+	text[length] = '\0';
+	return text;
 }
 
+bool token_starts_with(const ParserState* state, const Token* token, char c) {
+	return token->length > 0 && token_stream_text(state->tokens, token)[0] == c;
+}
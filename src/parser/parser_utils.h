@@ -2,27 +2,74 @@
 #define PARSER_UTILS_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include "../include/list_head.h"
 #include "../include/parser.h"
 #include "../include/site_context.h"
+#include "../include/dynamic_buffer.h"
+#include "../include/arena.h"
 
+// The tree as the parser builds it, in the state's arena. parse_tokens
+// flattens it into an Ast once the document is parsed.
 typedef struct {
-	struct list_head* current_node;
-	struct list_head* head;
+	struct list_head list;
+	struct list_head children;
 
-	SiteContext* s_context;
-	const char* current_file_path;
+	AstNodeType type;
+	char* data1;
+	char* data2;
+	bool is_wikilink; // data1 is the target; data2 is filled in on resolution
+} ParseNode;
+
+// Inline constructs whose closer the inline parser searches for.
+typedef enum {
+	CLOSER_ITALIC,
+	CLOSER_BOLD,
+	CLOSER_ITALIC_AND_BOLD,
+	CLOSER_CODE,
+	CLOSER_MATH,
+	CLOSER_DISPLAY_MATH,
+	CLOSER_LINK_TEXT,
+	CLOSER_LINK_URL,
+	CLOSER_WIKILINK,
+	CLOSER_KIND_COUNT
+} CloserKind;
+
+#define NO_CLOSER SIZE_MAX
+
+// The last search for a closer of one kind: a search starting anywhere in
+// [from, until] ends at `found`, so openers that fail do not rescan the line.
+typedef struct {
+	size_t from;
+	size_t until;
+	size_t found;
+	bool valid;
+} CloserMemo;
+
+typedef struct {
+	TokenStream* tokens;
+	size_t position;    // index of the next token; saving and restoring it backtracks
+
+	Arena* arena; // owns every node and string of the document
+
+	CloserMemo closers[CLOSER_KIND_COUNT];
 } ParserState;
 
-AstNode* create_ast_node(AstNodeType type, const char* data1, const char* data2);
-void add_child_node(AstNode* parent, AstNode* child);
+ParseNode* create_parse_node(ParserState* state, AstNodeType type, const char* data1, const char* data2);
+void add_child_node(ParseNode* parent, ParseNode* child);
 
+Token* token_at(ParserState* state, size_t index);
 Token* peek_token(ParserState* state);
+Token* peek_token_at(ParserState* state, size_t ahead);
 Token* consume_token(ParserState* state);
 bool match_token(ParserState* state, TokenType type);
+const LineInfo* line_at_cursor(ParserState* state);
 int calculate_indent(ParserState* state);
 void consume_indent(ParserState* state);
 
-const char* token_to_string(const Token* token);
+void append_token_text(DynamicBuffer* buffer, const ParserState* state, const Token* token);
+char* copy_token_text(ParserState* state, const Token* token);
+char* copy_token_range(ParserState* state, size_t from, size_t to);
+bool token_starts_with(const ParserState* state, const Token* token, char c);
 
 #endif
@@ -2,6 +2,7 @@
 #include <string.h>
 #include "../include/template_engine.h"
 #include "../include/hash_table.h"
+#include "../include/dependency_tracker.h"
 
 TemplateContext* create_template_context() {
 	return ht_create(128);
@@ -17,7 +18,9 @@ void free_template_context(TemplateContext* context) {
 }
 
 const char* get_from_context(TemplateContext* context, const char* key) {
-	return (const char*)ht_get(context, key);
+	const char* value = (const char*)ht_get(context, key);
+	record_context_lookup(context, key, value);
+	return value;
 }
 
 void copy_context(TemplateContext* dest, const TemplateContext* src) {
@@ -6,6 +6,7 @@
 #include "../include/template_engine.h"
 #include "../include/dynamic_buffer.h"
 #include "../include/list_head.h"
+#include "../include/dependency_tracker.h"
 #include "template_utils.h"
 
 typedef struct {
@@ -65,6 +66,7 @@ static char* render_components(char* html_content, struct list_head* dependency_
 		list_add_tail(&new_dep.list, dependency_stack);
 
 		char* component_content = read_file_into_string(component_path);
+		record_template_dependency(component_path, component_content);
 		if (!component_content) component_content = strdup("");
 
 		char* rendered_sub_component = render_components(component_content, dependency_stack);
@@ -135,6 +137,7 @@ static char* render_data(char* html_content, TemplateContext* context) {
 
 char* render_template(const char* layout_path, TemplateContext* context) {
 	char* final_html = read_file_into_string(layout_path);
+	record_template_dependency(layout_path, final_html);
 	if (!final_html) return NULL;
 
 	LIST_HEAD(dependency_stack);
@@ -0,0 +1,143 @@
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "text_scanner.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
+
+const bool text_special_chars[256] = {
+	['\0'] = true,
+	['#'] = true, ['*'] = true, ['-'] = true, ['['] = true, [']'] = true,
+	['('] = true, [')'] = true, ['!'] = true, ['>'] = true, ['\\'] = true,
+	['.'] = true, ['\n'] = true, ['\t'] = true, ['`'] = true, ['$'] = true,
+	['0' ... '9'] = true,
+};
+
+static const char* scan_text_scalar(const char* p) {
+	while (!is_text_special(*p)) p++;
+	return p;
+}
+
+#ifdef HAVE_X86_SIMD
+/*
+ * The vector scanners only do aligned loads. An aligned block never crosses a
+ * page boundary, so reading the rest of the block after the terminating NUL
+ * cannot fault, even though those bytes are outside the string. The loads
+ * are exempt from AddressSanitizer for that reason.
+ */
+__attribute__((target("sse2"), no_sanitize_address))
+static unsigned special_mask_sse2(const char* block) {
+	__m128i bytes = _mm_load_si128((const __m128i*)block);
+#define MATCH(c) _mm_cmpeq_epi8(bytes, _mm_set1_epi8(c))
+	__m128i hits = _mm_or_si128(
+		_mm_or_si128(_mm_or_si128(_mm_or_si128(MATCH('\0'), MATCH('\t')), _mm_or_si128(MATCH('\n'), MATCH('!'))),
+			_mm_or_si128(_mm_or_si128(MATCH('#'), MATCH('$')), _mm_or_si128(MATCH('('), MATCH(')')))),
+		_mm_or_si128(_mm_or_si128(_mm_or_si128(MATCH('*'), MATCH('-')), _mm_or_si128(MATCH('.'), MATCH('>'))),
+			_mm_or_si128(_mm_or_si128(MATCH('['), MATCH('\\')), _mm_or_si128(MATCH(']'), MATCH('`')))));
+#undef MATCH
+	// digits: (byte - '0') <= 9 as unsigned
+	__m128i digit = _mm_sub_epi8(bytes, _mm_set1_epi8('0'));
+	hits = _mm_or_si128(hits, _mm_cmpeq_epi8(_mm_min_epu8(digit, _mm_set1_epi8(9)), digit));
+	return (unsigned)_mm_movemask_epi8(hits);
+}
+
+__attribute__((target("sse2")))
+static const char* scan_text_sse2(const char* p) {
+	uintptr_t misalignment = (uintptr_t)p & 15;
+	const char* block = p - misalignment;
+	unsigned mask = special_mask_sse2(block) & (0xFFFFu << misalignment);
+	while (!mask) {
+		block += 16;
+		mask = special_mask_sse2(block);
+	}
+	return block + __builtin_ctz(mask);
+}
+
+/*
+ * AVX2 classifies with two nibble lookups. Each high nibble that has special
+ * bytes gets a bit (0x0_, 0x2_, 0x3_, 0x5_, 0x6_), and the low-nibble table
+ * holds the bits of the rows in which that column is special.
+ */
+__attribute__((target("avx2"), no_sanitize_address))
+static uint32_t special_mask_avx2(const char* block) {
+	const __m256i low_table = _mm256_setr_epi8(
+		0x15, 0x06, 0x04, 0x06, 0x06, 0x04, 0x04, 0x04, 0x06, 0x07, 0x03, 0x08, 0x08, 0x0A, 0x06, 0x00,
+		0x15, 0x06, 0x04, 0x06, 0x06, 0x04, 0x04, 0x04, 0x06, 0x07, 0x03, 0x08, 0x08, 0x0A, 0x06, 0x00);
+	const __m256i high_table = _mm256_setr_epi8(
+		0x01, 0x00, 0x02, 0x04, 0x00, 0x08, 0x10, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+		0x01, 0x00, 0x02, 0x04, 0x00, 0x08, 0x10, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+	const __m256i nibble = _mm256_set1_epi8(0x0F);
+
+	__m256i bytes = _mm256_load_si256((const __m256i*)block);
+	__m256i low = _mm256_shuffle_epi8(low_table, _mm256_and_si256(bytes, nibble));
+	__m256i high = _mm256_shuffle_epi8(high_table, _mm256_and_si256(_mm256_srli_epi16(bytes, 4), nibble));
+	__m256i misses = _mm256_cmpeq_epi8(_mm256_and_si256(low, high), _mm256_setzero_si256());
+	return ~(uint32_t)_mm256_movemask_epi8(misses);
+}
+
+__attribute__((target("avx2")))
+static const char* scan_text_avx2(const char* p) {
+	uintptr_t misalignment = (uintptr_t)p & 31;
+	const char* block = p - misalignment;
+	uint32_t mask = special_mask_avx2(block) & (0xFFFFFFFFu << misalignment);
+	while (!mask) {
+		block += 32;
+		mask = special_mask_avx2(block);
+	}
+	return block + __builtin_ctz(mask);
+}
+#endif
+
+static struct {
+	TextScanner scan;
+	const char* name;
+} scanner = { scan_text_scalar, "scalar" };
+
+static pthread_once_t scanner_once = PTHREAD_ONCE_INIT;
+
+static bool select_scanner(const char* name) {
+	if (strcmp(name, "scalar") == 0) {
+		scanner.scan = scan_text_scalar;
+		scanner.name = "scalar";
+		return true;
+	}
+#ifdef HAVE_X86_SIMD
+	__builtin_cpu_init();
+	if (strcmp(name, "sse2") == 0 && __builtin_cpu_supports("sse2")) {
+		scanner.scan = scan_text_sse2;
+		scanner.name = "sse2";
+		return true;
+	}
+	if (strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2")) {
+		scanner.scan = scan_text_avx2;
+		scanner.name = "avx2";
+		return true;
+	}
+#endif
+	return false;
+}
+
+static void select_default_scanner() {
+	if (!select_scanner("avx2") && !select_scanner("sse2")) {
+		select_scanner("scalar");
+	}
+}
+
+TextScanner current_text_scanner() {
+	pthread_once(&scanner_once, select_default_scanner);
+	return scanner.scan;
+}
+
+bool use_text_scanner(const char* name) {
+	pthread_once(&scanner_once, select_default_scanner);
+	return select_scanner(name);
+}
+
+const char* text_scanner_name() {
+	pthread_once(&scanner_once, select_default_scanner);
+	return scanner.name;
+}
@@ -0,0 +1,24 @@
+#ifndef TEXT_SCANNER_H
+#define TEXT_SCANNER_H
+
+#include <stdbool.h>
+
+// Bytes that end a text run: the punctuation the tokenizer splits on,
+// ASCII digits and the terminating NUL.
+extern const bool text_special_chars[256];
+
+static inline bool is_text_special(char c) {
+	return text_special_chars[(unsigned char)c];
+}
+
+// Returns the first special byte at or after p. The string must be NUL-terminated.
+typedef const char* (*TextScanner)(const char* p);
+
+TextScanner current_text_scanner();
+
+// Picks the implementation by name ("scalar", "sse2", "avx2"). Returns false if
+// the CPU or the build does not support it. By default the widest supported one is used.
+bool use_text_scanner(const char* name);
+const char* text_scanner_name();
+
+#endif
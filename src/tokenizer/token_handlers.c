@@ -3,93 +3,174 @@
 #include <string.h>
 #include "tokenizer_state.h"
 
-void add_token(TokenType type, const char* value, struct list_head* tokens) {
-	Token* new_token = (Token*)malloc(sizeof(Token));
-	if (!new_token) {
-		perror("Failed to allocate memory for token");
-		exit(EXIT_FAILURE);
+void add_token(TokenizerState* state, TokenType type, const char* start, size_t length) {
+	TokenList* tokens = state->tokens;
+	if (tokens->count == tokens->capacity) {
+		tokens->capacity = tokens->capacity ? tokens->capacity * 2 : 64;
+		tokens->items = realloc(tokens->items, tokens->capacity * sizeof(Token));
+		if (!tokens->items) {
+			perror("Failed to allocate memory for tokens");
+			exit(EXIT_FAILURE);
+		}
 	}
+	Token* new_token = &tokens->items[tokens->count++];
 	new_token->type = type;
-	new_token->value = value ? strdup(value) : NULL;
-	list_add_tail(&new_token->list, tokens);
+	new_token->line = state->line;
+	new_token->offset = start - state->source;
+	new_token->length = length;
+
+	bool continues_marker = (type == TOKEN_DASH || type == TOKEN_ASTERISK) && state->marker == type;
+	bool is_marker = type == TOKEN_NUMBER || type == TOKEN_DASH || type == TOKEN_ASTERISK;
+	state->marker = is_marker && (state->block_start || continues_marker) ? type : TOKEN_EOF;
+	state->block_start = type == TOKEN_NEWLINE || (state->block_start && (type == TOKEN_TAB || type == TOKEN_HASH));
+	state->after_rbracket = type == TOKEN_RBRACKET;
+	if (type == TOKEN_LPAREN) state->open_destinations++;
+	if (type == TOKEN_RPAREN && state->open_destinations > 0) state->open_destinations--;
+	if (type == TOKEN_NEWLINE) state->line++;
 }
 
-void append_char_to_buffer(DynamicBuffer* buffer, char c) {
-	buffer_append_formatted(buffer, "%c", c);
+/*
+ * Whether punctuation c at the current position has to be its own token.
+ * Tabs always are, since node text leaves them out. The parser reads '#',
+ * '>' and digits only where a block starts, '-' and
+ * '.' only in list and rule markers, '(' only right after ']', ')' only to end
+ * a link destination and '!' only before '['. Anywhere else they are plain
+ * text and join the surrounding text run, which gives the same AST.
+ */
+bool is_structural(TokenizerState* state, char c) {
+	bool in_text = state->text_start != NULL;
+	bool block_start = state->block_start && !in_text;
+	TokenType marker = in_text ? TOKEN_EOF : state->marker;
+
+	switch (c) {
+		case '\n': case '\t': case '*': case '`': case '$': case '[': case ']':
+			return true;
+		case '#': case '>':
+			return block_start;
+		case '-':
+			return block_start || marker == TOKEN_DASH;
+		case '.':
+			return marker != TOKEN_EOF;
+		case '(':
+			return !in_text && state->after_rbracket;
+		case ')':
+			return state->open_destinations > 0;
+		case '!':
+			return state->current[1] == '[';
+		case '\\':
+			return false;
+		default:
+			return isdigit((unsigned char)c) && block_start;
+	}
 }
 
-void flush_buffer_as_token(DynamicBuffer* buffer, TokenType type, struct list_head* tokens) {
-	if (buffer->length > 0) {
-		add_token(type, buffer->content, tokens);
-		buffer->length = 0;
-		buffer->content[0] = '\0';
+// Emits the text run that ends at the current position, if there is one.
+void flush_text_run(TokenizerState* state) {
+	if (state->text_start && state->text_start < state->current) {
+		add_token(state, TOKEN_TEXT, state->text_start, state->current - state->text_start);
 	}
+	state->text_start = NULL;
 }
 
 void handle_punctuation(TokenizerState* state, char c) {
-	flush_buffer_as_token(state->text_buffer, TOKEN_TEXT, state->tokens);
+	flush_text_run(state);
+	TokenType type;
 	switch (c) {
-		case '#': add_token(TOKEN_HASH, NULL, state->tokens); break;
-		case '*': add_token(TOKEN_ASTERISK, NULL, state->tokens); break;
-		case '-': add_token(TOKEN_DASH, NULL, state->tokens); break;
-		case '\n': add_token(TOKEN_NEWLINE, NULL, state->tokens); break;
-		case '\t': add_token(TOKEN_TAB, NULL, state->tokens); break;
-		case '[': add_token(TOKEN_LBRACKET, NULL, state->tokens); break;
-		case ']': add_token(TOKEN_RBRACKET, NULL, state->tokens); break;
-		case '(': add_token(TOKEN_LPAREN, NULL, state->tokens); break;
-		case ')': add_token(TOKEN_RPAREN, NULL, state->tokens); break;
-		case '!': add_token(TOKEN_EXCLAMATION, NULL, state->tokens); break;
-		case '>': add_token(TOKEN_GREATER_THAN, NULL, state->tokens); break;
-		case '\\': add_token(TOKEN_BACKSLASH, NULL, state->tokens); break;
-		case '.': add_token(TOKEN_DOT, NULL, state->tokens); break;
-		case '`': add_token(TOKEN_BACKTICK, NULL, state->tokens); break;
-		case '$': add_token(TOKEN_DOLLAR, NULL, state->tokens); break;
+		case '#': type = TOKEN_HASH; break;
+		case '*': type = TOKEN_ASTERISK; break;
+		case '-': type = TOKEN_DASH; break;
+		case '\n': type = TOKEN_NEWLINE; break;
+		case '\t': type = TOKEN_TAB; break;
+		case '[': type = TOKEN_LBRACKET; break;
+		case ']': type = TOKEN_RBRACKET; break;
+		case '(': type = TOKEN_LPAREN; break;
+		case ')': type = TOKEN_RPAREN; break;
+		case '!': type = TOKEN_EXCLAMATION; break;
+		case '>': type = TOKEN_GREATER_THAN; break;
+		case '\\': type = TOKEN_BACKSLASH; break;
+		case '.': type = TOKEN_DOT; break;
+		case '`': type = TOKEN_BACKTICK; break;
+		case '$': type = TOKEN_DOLLAR; break;
+		default: state->current++; return;
 	}
+	add_token(state, type, state->current, 1);
 	state->current++;
 }
 
-void handle_fenced_code_block(TokenizerState* state) {
-	flush_buffer_as_token(state->text_buffer, TOKEN_TEXT, state->tokens);
-	add_token(TOKEN_BACKTICK, NULL, state->tokens);
-	add_token(TOKEN_BACKTICK, NULL, state->tokens);
-	add_token(TOKEN_BACKTICK, NULL, state->tokens);
-	state->current += 3;
+static void add_fence(TokenizerState* state) {
+	for (int i = 0; i < 3; i++) {
+		add_token(state, TOKEN_BACKTICK, state->current++, 1);
+	}
+}
+
+// True when the bytes up to and including p have not been read yet (chunked input).
+static bool beyond_input(const TokenizerState* state, const char* p) {
+	return !state->input_complete && p >= state->end;
+}
+
+// A closing fence starts its line, after optional indentation. Backticks
+// elsewhere in the body (inline code in a listing, say) do not close it.
+// Candidates before `from` have already been rejected.
+static const char* find_closing_fence(const char* body, const char* from) {
+	for (const char* fence = strstr(from, "```"); fence; fence = strstr(fence + 3, "```")) {
+		const char* line_start = fence;
+		while (line_start > body && (line_start[-1] == ' ' || line_start[-1] == '\t')) {
+			line_start--;
+		}
+		if (line_start == body || line_start[-1] == '\n') return fence;
+	}
+	return NULL;
+}
 
-	while (*state->current && *state->current != '\n') {
-		append_char_to_buffer(state->text_buffer, *state->current++);
+// Emits nothing and returns false if the block is not complete in the input read so far.
+bool handle_fenced_code_block(TokenizerState* state) {
+	const char* info = state->current + 3;
+	const char* line_end = strchr(info, '\n');
+	if (!line_end) {
+		if (!state->input_complete) return false;
+		line_end = info + strlen(info);
 	}
-	flush_buffer_as_token(state->text_buffer, TOKEN_TEXT, state->tokens);
-	if (*state->current == '\n') {
-		add_token(TOKEN_NEWLINE, NULL, state->tokens);
-		state->current++;
+
+	// the body is one text span up to the closing fence, or to the end of the source
+	const char* body = *line_end == '\n' ? line_end + 1 : line_end;
+	const char* search_from = state->fence_search_from > body ? state->fence_search_from : body;
+	const char* fence = find_closing_fence(body, search_from);
+	if (!fence && !state->input_complete) {
+		// resume after what was searched; the last two bytes may start a fence
+		state->fence_search_from = state->end - 2 > body ? state->end - 2 : body;
+		return false;
 	}
+	const char* body_end = fence ? fence : body + strlen(body);
+	state->fence_search_from = NULL;
 
-	while (*state->current) {
-		if (strncmp(state->current, "```", 3) == 0) {
-			flush_buffer_as_token(state->text_buffer, TOKEN_TEXT, state->tokens);
-			add_token(TOKEN_BACKTICK, NULL, state->tokens);
-			add_token(TOKEN_BACKTICK, NULL, state->tokens);
-			add_token(TOKEN_BACKTICK, NULL, state->tokens);
-			state->current += 3;
-			return;
-		}
-		append_char_to_buffer(state->text_buffer, *state->current++);
+	flush_text_run(state);
+	add_fence(state);
+	if (line_end > state->current) {
+		add_token(state, TOKEN_TEXT, state->current, line_end - state->current);
+	}
+	if (*line_end == '\n') {
+		add_token(state, TOKEN_NEWLINE, line_end, 1);
+	}
+	if (body_end > body) {
+		add_token(state, TOKEN_TEXT, body, body_end - body);
+	}
+	state->current = body_end;
+	if (fence) {
+		add_fence(state);
+		state->block_start = true;
 	}
+	return true;
 }
 
-void handle_number(TokenizerState* state) {
-	flush_buffer_as_token(state->text_buffer, TOKEN_TEXT, state->tokens);
-	
-	const char* start = state->current;
-	while (isdigit(*state->current)) {
-		state->current++;
+bool handle_number(TokenizerState* state) {
+	const char* end = state->current;
+	while (isdigit((unsigned char)*end)) {
+		end++;
 	}
-	
-	size_t len = state->current - start;
-	char* value = malloc(len + 1);
-	strncpy(value, start, len);
-	value[len] = '\0';
+	if (beyond_input(state, end)) return false;
 
-	add_token(TOKEN_NUMBER, value, state->tokens);
-	free(value);
+	flush_text_run(state);
+	add_token(state, TOKEN_NUMBER, state->current, end - state->current);
+	state->current = end;
+	return true;
 }
@@ -0,0 +1,285 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/tokenizer.h"
+#include "tokenizer_state.h"
+
+#define TOKEN_CHUNK_SIZE 256
+
+/*
+ * Retained tokens live in chunks of TOKEN_CHUNK_SIZE. The chunk pointers form
+ * a ring indexed by absolute chunk number, so appending never moves a token and
+ * releasing drops whole chunks from the front. The window grows only while the
+ * parser holds on to older tokens (backtracking within a block).
+ *
+ * A stream over a file reads it chunk_size bytes at a time into a text window.
+ * Before each read the window drops the bytes in front of both the oldest
+ * retained token and the tokenizer's pending run, so it holds one chunk plus
+ * the text of the tokens still retained. Token offsets stay relative to the
+ * start of the input; window_offset maps them into the window.
+ */
+struct TokenStream {
+	TokenizerState state;
+	TokenList pending;      // tokens of the last tokenizer step not stored yet
+
+	Token** chunks;         // ring of chunk pointers, chunk_capacity is a power of two
+	size_t chunk_capacity;
+	size_t first_chunk;     // absolute number of the oldest retained chunk
+	size_t chunk_count;
+	size_t produced;        // absolute index one past the newest stored token
+	size_t peak_chunks;     // most chunks retained at once
+
+	Token* spare_chunk;     // last released chunk, reused for the next one
+
+	LineInfo* lines;        // lines[i] describes line first_line + i
+	size_t first_line;
+	size_t line_count;
+	size_t line_capacity;
+	bool line_started;      // the newest line has its first significant token
+
+	FILE* file;             // NULL for a stream over a string
+	size_t chunk_size;
+	char* window;           // state.source for a file stream, owned by it
+	size_t window_length;
+	size_t window_capacity;
+	size_t window_offset;   // input offset of window[0]
+};
+
+TokenStream* create_token_stream(const char* source) {
+	TokenStream* stream = calloc(1, sizeof(TokenStream));
+	if (!stream) {
+		perror("Failed to allocate token stream");
+		exit(EXIT_FAILURE);
+	}
+	stream->pending.source = source;
+	init_tokenizer_state(&stream->state, source, &stream->pending);
+
+	stream->chunk_capacity = 4;
+	stream->chunks = calloc(stream->chunk_capacity, sizeof(Token*));
+	if (!stream->chunks) {
+		perror("Failed to allocate token stream");
+		exit(EXIT_FAILURE);
+	}
+	return stream;
+}
+
+TokenStream* create_file_token_stream(FILE* file, size_t chunk_size) {
+	if (chunk_size == 0) chunk_size = 1;
+	char* window = malloc(chunk_size * 2 + 1);
+	if (!window) {
+		perror("Failed to allocate tokenizer window");
+		exit(EXIT_FAILURE);
+	}
+	window[0] = '\0';
+
+	TokenStream* stream = create_token_stream(window);
+	stream->file = file;
+	stream->chunk_size = chunk_size;
+	stream->window = window;
+	stream->window_capacity = chunk_size * 2 + 1;
+	stream->state.input_complete = false;
+	stream->state.end = window;
+	return stream;
+}
+
+const char* token_stream_text(const TokenStream* stream, const Token* token) {
+	return stream->state.source + (token->offset - stream->window_offset);
+}
+
+static Token** chunk_slot(TokenStream* stream, size_t chunk) {
+	return &stream->chunks[chunk & (stream->chunk_capacity - 1)];
+}
+
+static void grow_chunk_ring(TokenStream* stream) {
+	size_t new_capacity = stream->chunk_capacity * 2;
+	Token** chunks = calloc(new_capacity, sizeof(Token*));
+	if (!chunks) {
+		perror("Failed to grow token stream");
+		exit(EXIT_FAILURE);
+	}
+	for (size_t i = 0; i < stream->chunk_count; i++) {
+		size_t chunk = stream->first_chunk + i;
+		chunks[chunk & (new_capacity - 1)] = *chunk_slot(stream, chunk);
+	}
+	free(stream->chunks);
+	stream->chunks = chunks;
+	stream->chunk_capacity = new_capacity;
+}
+
+// Extends the line table with the token about to be stored.
+static void record_line(TokenStream* stream, const Token* token) {
+	size_t line = token->line;
+	if (stream->line_count == 0 || line >= stream->first_line + stream->line_count) {
+		if (stream->line_count == 0) stream->first_line = line;
+		if (stream->line_count == stream->line_capacity) {
+			stream->line_capacity = stream->line_capacity ? stream->line_capacity * 2 : 64;
+			stream->lines = realloc(stream->lines, stream->line_capacity * sizeof(LineInfo));
+			if (!stream->lines) {
+				perror("Failed to grow line table");
+				exit(EXIT_FAILURE);
+			}
+		}
+		LineInfo* info = &stream->lines[stream->line_count++];
+		info->first_token = stream->produced;
+		info->indent = 0;
+		info->first_type = TOKEN_EOF;
+		info->blank = true;
+		stream->line_started = false;
+	}
+
+	if (stream->line_started) return;
+	LineInfo* info = &stream->lines[stream->line_count - 1];
+	if (token->type == TOKEN_TAB) {
+		info->indent++;
+	} else {
+		info->first_type = token->type;
+		info->blank = token->type == TOKEN_NEWLINE || token->type == TOKEN_EOF;
+		stream->line_started = true;
+	}
+}
+
+static void store_token(TokenStream* stream, const Token* token) {
+	record_line(stream, token);
+	size_t chunk = stream->produced / TOKEN_CHUNK_SIZE;
+	if (stream->produced % TOKEN_CHUNK_SIZE == 0) {
+		if (stream->chunk_count == 0) stream->first_chunk = chunk;
+		if (stream->chunk_count == stream->chunk_capacity) grow_chunk_ring(stream);
+
+		Token* storage = stream->spare_chunk;
+		stream->spare_chunk = NULL;
+		if (!storage) storage = malloc(TOKEN_CHUNK_SIZE * sizeof(Token));
+		if (!storage) {
+			perror("Failed to allocate token chunk");
+			exit(EXIT_FAILURE);
+		}
+		*chunk_slot(stream, chunk) = storage;
+		stream->chunk_count++;
+		if (stream->chunk_count > stream->peak_chunks) stream->peak_chunks = stream->chunk_count;
+	}
+	(*chunk_slot(stream, chunk))[stream->produced % TOKEN_CHUNK_SIZE] = *token;
+	stream->produced++;
+}
+
+// Drops the window bytes that neither a retained token nor the tokenizer
+// needs any more, and reads the next chunk behind the rest.
+static bool read_more_input(TokenStream* stream) {
+	TokenizerState* state = &stream->state;
+	if (!stream->file || state->input_complete) return false;
+
+	const char* keep = state->text_start ? state->text_start : state->current;
+	if (stream->chunk_count > 0) {
+		const Token* oldest = &(*chunk_slot(stream, stream->first_chunk))[0];
+		const char* oldest_text = token_stream_text(stream, oldest);
+		if (oldest_text < keep) keep = oldest_text;
+	}
+
+	size_t shift = keep - stream->window;
+	size_t current = state->current - keep;
+	size_t text_start = state->text_start ? (size_t)(state->text_start - keep) : 0;
+	size_t fence_search_from = state->fence_search_from ? (size_t)(state->fence_search_from - keep) : 0;
+	memmove(stream->window, keep, stream->window_length - shift);
+	stream->window_length -= shift;
+	stream->window_offset += shift;
+
+	if (stream->window_length + stream->chunk_size + 1 > stream->window_capacity) {
+		// the retained tokens and the pending one outgrew the window
+		while (stream->window_length + stream->chunk_size + 1 > stream->window_capacity) stream->window_capacity *= 2;
+		stream->window = realloc(stream->window, stream->window_capacity);
+		if (!stream->window) {
+			perror("Failed to grow tokenizer window");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	size_t read = fread(stream->window + stream->window_length, 1, stream->chunk_size, stream->file);
+	stream->window_length += read;
+	stream->window[stream->window_length] = '\0';
+
+	state->source = stream->window;
+	state->current = stream->window + current;
+	if (state->text_start) state->text_start = stream->window + text_start;
+	if (state->fence_search_from) state->fence_search_from = stream->window + fence_search_from;
+	state->end = stream->window + stream->window_length;
+	state->input_complete = read < stream->chunk_size && (feof(stream->file) || ferror(stream->file));
+	return true;
+}
+
+// Runs the tokenizer for one step, reading more of a file when it asks
+// for input, and stores what it produced.
+static bool fill_token_stream(TokenStream* stream) {
+	stream->pending.count = 0;
+	while (!tokenizer_step(&stream->state)) {
+		if (!stream->state.needs_input || !read_more_input(stream)) return false;
+	}
+	for (size_t i = 0; i < stream->pending.count; i++) {
+		Token token = stream->pending.items[i];
+		token.offset += stream->window_offset;
+		store_token(stream, &token);
+	}
+	return true;
+}
+
+Token* token_stream_get(TokenStream* stream, size_t index) {
+	while (index >= stream->produced) {
+		if (!fill_token_stream(stream)) return NULL;
+	}
+
+	size_t chunk = index / TOKEN_CHUNK_SIZE;
+	if (chunk < stream->first_chunk) {
+		fprintf(stderr, "Error: Token %zu was requested after it was released.\n", index);
+		exit(EXIT_FAILURE);
+	}
+	return &(*chunk_slot(stream, chunk))[index % TOKEN_CHUNK_SIZE];
+}
+
+const LineInfo* token_stream_line(TokenStream* stream, size_t index) {
+	const Token* token = token_stream_get(stream, index);
+	if (!token) return NULL;
+
+	size_t line = token->line;
+	// produce the rest of the indent and the first token after it
+	while (line == stream->first_line + stream->line_count - 1 && !stream->line_started) {
+		if (!fill_token_stream(stream)) break;
+	}
+	return &stream->lines[line - stream->first_line];
+}
+
+void token_stream_release(TokenStream* stream, size_t index) {
+	while (stream->chunk_count > 0 && (stream->first_chunk + 1) * TOKEN_CHUNK_SIZE <= index) {
+		Token** slot = chunk_slot(stream, stream->first_chunk);
+		if (stream->spare_chunk) free(*slot);
+		else stream->spare_chunk = *slot;
+		*slot = NULL;
+		stream->first_chunk++;
+		stream->chunk_count--;
+	}
+
+	// drop the lines that end before index, keeping the table compact
+	size_t dropped = 0;
+	while (dropped + 1 < stream->line_count && stream->lines[dropped + 1].first_token <= index) {
+		dropped++;
+	}
+	if (dropped > 0) {
+		stream->line_count -= dropped;
+		stream->first_line += dropped;
+		memmove(stream->lines, stream->lines + dropped, stream->line_count * sizeof(LineInfo));
+	}
+}
+
+size_t token_stream_peak_window(const TokenStream* stream) {
+	return stream->peak_chunks * TOKEN_CHUNK_SIZE;
+}
+
+void free_token_stream(TokenStream* stream) {
+	if (!stream) return;
+	for (size_t i = 0; i < stream->chunk_count; i++) {
+		free(*chunk_slot(stream, stream->first_chunk + i));
+	}
+	free(stream->chunks);
+	free(stream->spare_chunk);
+	free(stream->lines);
+	free_tokens(&stream->pending);
+	free(stream->window);
+	free(stream);
+}
@@ -1,53 +1,99 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <stdbool.h>
 #include <ctype.h>
 
 #include "../include/tokenizer.h"
 #include "tokenizer_state.h"
+#include "text_scanner.h"
 
 void handle_punctuation(TokenizerState* state, char c);
-void handle_fenced_code_block(TokenizerState* state);
-void handle_number(TokenizerState* state);
+bool handle_fenced_code_block(TokenizerState* state);
+bool handle_number(TokenizerState* state);
 
-static bool is_punctuation(char c) {
-	return strchr("#*-[]()!>\\.\n\t`$", c) != NULL;
+void init_tokenizer_state(TokenizerState* state, const char* content, TokenList* output) {
+	state->source = content;
+	state->current = content;
+	state->text_start = NULL;
+	state->tokens = output;
+	state->scan_text = current_text_scanner();
+	state->finished = false;
+	state->line = 0;
+	state->end = NULL;
+	state->input_complete = true;
+	state->needs_input = false;
+	state->fence_search_from = NULL;
+	state->block_start = true;
+	state->marker = TOKEN_EOF;
+	state->after_rbracket = false;
+	state->open_destinations = 0;
 }
 
-void tokenize_string(const char* content, struct list_head* output) {
-	TokenizerState state;
-	state.current = content;
-	state.tokens = output;
-	state.text_buffer = create_dynamic_buffer(256);
+// Tokenizes until at least one token has been appended to state->tokens.
+// Returns false once the source is exhausted and TOKEN_EOF has been emitted,
+// or, for chunked input, when needs_input is set.
+bool tokenizer_step(TokenizerState* state) {
+	state->needs_input = false;
+	if (state->finished) return false;
 
-	if (!state.text_buffer) {
-		perror("Failed to create dynamic buffer");
-		exit(EXIT_FAILURE);
-	}
-
-	while (*state.current != '\0') {
-		if (strncmp(state.current, "```", 3) == 0) {
-			handle_fenced_code_block(&state);
-		} else if (is_punctuation(*state.current)) {
-			handle_punctuation(&state, *state.current);
-		} else if (isdigit(*state.current)) {
-			handle_number(&state);
+	size_t initial_count = state->tokens->count;
+	while (state->tokens->count == initial_count && !state->needs_input) {
+		char c = *state->current;
+		bool input_left = !state->input_complete;
+		if (c == '\0') {
+			if (input_left && state->current == state->end) {
+				state->needs_input = true;
+				break;
+			}
+			flush_text_run(state);
+			add_token(state, TOKEN_EOF, state->current, 0);
+			state->finished = true;
+		} else if (!is_text_special(c)) {
+			// text is not copied; the run is emitted as one span when it ends
+			if (!state->text_start) state->text_start = state->current;
+			state->current = state->scan_text(state->current);
+		} else if ((c == '`' && input_left && state->end - state->current < 3)
+				|| (c == '!' && input_left && state->end - state->current < 2)) {
+			state->needs_input = true;
+		} else if (c == '`' && strncmp(state->current, "```", 3) == 0) {
+			state->needs_input = !handle_fenced_code_block(state);
+		} else if (!is_structural(state, c)) {
+			if (!state->text_start) state->text_start = state->current;
+			state->current++;
+		} else if (isdigit((unsigned char)c)) {
+			state->needs_input = !handle_number(state);
 		} else {
-			append_char_to_buffer(state.text_buffer, *state.current);
-			state.current++;
+			handle_punctuation(state, c);
 		}
 	}
+	return state->tokens->count > initial_count;
+}
 
-	flush_buffer_as_token(state.text_buffer, TOKEN_TEXT, state.tokens);
-	char* final_content = destroy_buffer_and_get_content(state.text_buffer);
-	free(final_content);
-	
-	add_token(TOKEN_EOF, NULL, state.tokens);
+// Drain-all adapter over the pull-based stream, for callers that want every token at once.
+void tokenize_string(const char* content, TokenList* output) {
+	output->source = content;
+	output->items = NULL;
+	output->count = 0;
+	output->capacity = 0;
 
+	TokenStream* stream = create_token_stream(content);
+	const Token* token;
+	for (size_t i = 0; (token = token_stream_get(stream, i)); i++) {
+		if (output->count == output->capacity) {
+			output->capacity = output->capacity ? output->capacity * 2 : 64;
+			output->items = realloc(output->items, output->capacity * sizeof(Token));
+			if (!output->items) {
+				perror("Failed to allocate memory for tokens");
+				exit(EXIT_FAILURE);
+			}
+		}
+		output->items[output->count++] = *token;
+		token_stream_release(stream, i + 1);
+	}
+	free_token_stream(stream);
 }
 
-void tokenize_file(FILE* file, struct list_head* output) {
+char* tokenize_file(FILE* file, TokenList* output) {
 	fseek(file, 0, SEEK_END);
 	long length = ftell(file);
 	fseek(file, 0, SEEK_SET);
@@ -58,10 +104,26 @@ void tokenize_file(FILE* file, struct list_head* output) {
 		exit(EXIT_FAILURE);
 	}
 
-	fread(buffer, 1, length, file);
-	buffer[length] = '\0';
+	size_t read = fread(buffer, 1, length, file);
+	buffer[read] = '\0';
 
 	tokenize_string(buffer, output);
+	return buffer;
+}
+
+void tokenize_file_chunked(FILE* file, size_t chunk_size, TokenSink sink, void* context) {
+	TokenStream* stream = create_file_token_stream(file, chunk_size);
+	const Token* token;
+	for (size_t i = 0; (token = token_stream_get(stream, i)); i++) {
+		sink(token, token_stream_text(stream, token), context);
+		token_stream_release(stream, i + 1);
+	}
+	free_token_stream(stream);
+}
 
-	free(buffer);
+void free_tokens(TokenList* tokens) {
+	free(tokens->items);
+	tokens->items = NULL;
+	tokens->count = 0;
+	tokens->capacity = 0;
 }
@@ -1,18 +1,39 @@
 #ifndef TOKENIZER_STATE_H
 #define TOKENIZER_STATE_H
 
-#include "../include/list_head.h"
+#include <stdbool.h>
+
 #include "../include/tokenizer.h"
-#include "../include/dynamic_buffer.h"
+#include "text_scanner.h"
 
 typedef struct {
+	const char* source;
 	const char* current;
-	struct list_head* tokens;
-	DynamicBuffer* text_buffer;
+	const char* text_start; // start of the pending text run, NULL if none
+	TokenList* tokens;
+	TextScanner scan_text;
+	bool finished;          // TOKEN_EOF has been emitted
+	uint32_t line;          // line of the next token
+
+	// Chunked input: only [source, end) has been read. Until input_complete is
+	// set, a step that would need bytes past end stops and sets needs_input.
+	const char* end;
+	bool input_complete;
+	bool needs_input;
+	const char* fence_search_from; // where an unfinished closing-fence search resumes
+
+	// Context for coalescing: punctuation the parser only reads in certain
+	// places is emitted as a token there and merged into text elsewhere.
+	bool block_start;          // next token may start a block (after a newline, a closing fence, or leading tabs/hashes)
+	TokenType marker;          // list/rule marker just emitted at a block start, TOKEN_EOF if none
+	bool after_rbracket;       // last token was ']', so '(' may open a link destination
+	size_t open_destinations;  // "](" seen without their ')' yet
 } TokenizerState;
 
-void append_char_to_buffer(DynamicBuffer* buffer, char c);
-void flush_buffer_as_token(DynamicBuffer* buffer, TokenType type, struct list_head* tokens);
-void add_token(TokenType type, const char* value, struct list_head* tokens);
+void init_tokenizer_state(TokenizerState* state, const char* content, TokenList* output);
+bool tokenizer_step(TokenizerState* state);
+void add_token(TokenizerState* state, TokenType type, const char* start, size_t length);
+void flush_text_run(TokenizerState* state);
+bool is_structural(TokenizerState* state, char c);
 
 #endif
@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+
+#define ARENA_ALIGNMENT _Alignof(max_align_t)
+
+struct ArenaChunk {
+	ArenaChunk* next;
+	size_t used;
+	size_t capacity;
+	_Alignas(max_align_t) char data[];
+};
+
+static ArenaChunk* create_chunk(size_t capacity) {
+	ArenaChunk* chunk = malloc(sizeof(ArenaChunk) + capacity);
+	if (!chunk) {
+		perror("Failed to allocate arena chunk");
+		exit(EXIT_FAILURE);
+	}
+	chunk->next = NULL;
+	chunk->used = 0;
+	chunk->capacity = capacity;
+	return chunk;
+}
+
+Arena* arena_create(size_t chunk_size) {
+	Arena* arena = malloc(sizeof(Arena));
+	if (!arena) {
+		perror("Failed to allocate arena");
+		exit(EXIT_FAILURE);
+	}
+	arena->chunk_size = chunk_size;
+	arena->chunks = create_chunk(chunk_size);
+	return arena;
+}
+
+void* arena_alloc(Arena* arena, size_t size) {
+	size = (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+	ArenaChunk* head = arena->chunks;
+
+	if (head->capacity - head->used < size) {
+		// oversized requests get a chunk of their own behind the head, so
+		// the space left in the head stays usable
+		if (size > arena->chunk_size / 4) {
+			ArenaChunk* chunk = create_chunk(size);
+			chunk->used = size;
+			chunk->next = head->next;
+			head->next = chunk;
+			return chunk->data;
+		}
+		head = create_chunk(arena->chunk_size);
+		head->next = arena->chunks;
+		arena->chunks = head;
+	}
+
+	void* memory = head->data + head->used;
+	head->used += size;
+	return memory;
+}
+
+char* arena_strndup(Arena* arena, const char* text, size_t length) {
+	char* copy = arena_alloc(arena, length + 1);
+	memcpy(copy, text, length);
+	copy[length] = '\0';
+	return copy;
+}
+
+char* arena_strdup(Arena* arena, const char* text) {
+	return arena_strndup(arena, text, strlen(text));
+}
+
+void arena_reset(Arena* arena) {
+	ArenaChunk* keep = NULL;
+	ArenaChunk* chunk = arena->chunks;
+	while (chunk) {
+		ArenaChunk* next = chunk->next;
+		if (!keep && chunk->capacity == arena->chunk_size) {
+			keep = chunk;
+		} else {
+			free(chunk);
+		}
+		chunk = next;
+	}
+	if (!keep) keep = create_chunk(arena->chunk_size);
+	keep->next = NULL;
+	keep->used = 0;
+	arena->chunks = keep;
+}
+
+void arena_free(Arena* arena) {
+	if (!arena) return;
+	ArenaChunk* chunk = arena->chunks;
+	while (chunk) {
+		ArenaChunk* next = chunk->next;
+		free(chunk);
+		chunk = next;
+	}
+	free(arena);
+}
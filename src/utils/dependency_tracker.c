@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/dependency_tracker.h"
+#include "../include/hash_table.h"
+
+typedef struct {
+	DependencyList* list;
+	TemplateContext* global_context;
+	HashTable* seen;
+} DependencyRecorder;
+
+static __thread DependencyRecorder* active_recorder = NULL;
+
+void dependency_list_init(DependencyList* list) {
+	list->items = NULL;
+	list->count = 0;
+	list->capacity = 0;
+}
+
+void dependency_list_add(DependencyList* list, DependencyKind kind, const char* name, const unsigned char* digest) {
+	if (list->count == list->capacity) {
+		list->capacity = list->capacity ? list->capacity * 2 : 16;
+		list->items = realloc(list->items, list->capacity * sizeof(Dependency));
+	}
+
+	Dependency* dep = &list->items[list->count++];
+	dep->kind = kind;
+	dep->name = strdup(name);
+	memcpy(dep->digest, digest, HASH_DIGEST_SIZE);
+}
+
+void dependency_list_free(DependencyList* list) {
+	for (size_t i = 0; i < list->count; i++) {
+		free(list->items[i].name);
+	}
+	free(list->items);
+	dependency_list_init(list);
+}
+
+void dependency_digest(const char* value, unsigned char* digest) {
+	if (!value) {
+		memset(digest, 0, HASH_DIGEST_SIZE);
+		return;
+	}
+	generate_buffer_digest(value, strlen(value), digest);
+}
+
+void start_dependency_recording(DependencyList* list, TemplateContext* global_context) {
+	DependencyRecorder* recorder = malloc(sizeof(DependencyRecorder));
+	recorder->list = list;
+	recorder->global_context = global_context;
+	recorder->seen = ht_create(64);
+	active_recorder = recorder;
+}
+
+void stop_dependency_recording() {
+	if (!active_recorder) return;
+	ht_destroy(active_recorder->seen, NULL);
+	free(active_recorder);
+	active_recorder = NULL;
+}
+
+// The key is the kind and the whole name; two long names sharing a prefix
+// must not collapse into one dependency.
+static bool first_record(DependencyKind kind, const char* name) {
+	char stack_key[1024];
+	size_t length = snprintf(NULL, 0, "%d:%s", (int)kind, name);
+	char* seen_key = length < sizeof(stack_key) ? stack_key : malloc(length + 1);
+	snprintf(seen_key, length + 1, "%d:%s", (int)kind, name);
+
+	bool first = !ht_get(active_recorder->seen, seen_key);
+	if (first) ht_set(active_recorder->seen, seen_key, (void*)1);
+
+	if (seen_key != stack_key) free(seen_key);
+	return first;
+}
+
+static void record_dependency(DependencyKind kind, const char* name, const char* value) {
+	if (!first_record(kind, name)) return;
+
+	unsigned char digest[HASH_DIGEST_SIZE];
+	dependency_digest(value, digest);
+	dependency_list_add(active_recorder->list, kind, name, digest);
+}
+
+void record_template_dependency(const char* path, const char* content) {
+	if (!active_recorder) return;
+	record_dependency(DEP_TEMPLATE, path, content);
+}
+
+void record_context_lookup(TemplateContext* context, const char* key, const char* value) {
+	if (!active_recorder) return;
+
+	// values set by the page itself are covered by its other dependencies;
+	// only lookups answered by the global context (or by nobody) are recorded
+	const char* global_value = (const char*)ht_get(active_recorder->global_context, key);
+	if (value && context != active_recorder->global_context && (!global_value || strcmp(global_value, value) != 0)) {
+		return;
+	}
+	record_dependency(DEP_CONFIG, key, value);
+}
+
+void record_link_dependency(const char* target, const char* url) {
+	if (!active_recorder) return;
+	record_dependency(DEP_LINK, target, url);
+}
+
+void record_value_dependency(const char* key, const char* value) {
+	if (!active_recorder) return;
+	record_dependency(DEP_VALUE, key, value);
+}
+
+void record_value_digest(const char* key, const unsigned char* digest) {
+	if (!active_recorder || !first_record(DEP_VALUE, key)) return;
+	dependency_list_add(active_recorder->list, DEP_VALUE, key, digest);
+}
@@ -51,6 +51,14 @@ void buffer_append_formatted(DynamicBuffer* buffer, const char* format, ...) {
 	buffer->length += required_len;
 }
 
+// raw append, data may contain NUL bytes; content stays NUL-terminated
+void buffer_append_bytes(DynamicBuffer* buffer, const void* data, size_t length) {
+	ensure_buffer_capacity(buffer, length);
+	memcpy(buffer->content + buffer->length, data, length);
+	buffer->length += length;
+	buffer->content[buffer->length] = '\0';
+}
+
 char* destroy_buffer_and_get_content(DynamicBuffer* buffer) {
 	if (!buffer) return NULL;
 	char* final_content = buffer->content;
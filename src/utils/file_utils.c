@@ -6,6 +6,7 @@
 #include <errno.h>
 
 #include "../include/file_utils.h"
+#include "../include/output_writer.h"
 
 #define MAX_PATH_LENGTH 1024
 
@@ -97,21 +98,8 @@ void copy_static_files(const char* src_dir, const char* dest_dir) {
 		if (S_ISDIR(path_stat.st_mode)) {
 			copy_static_files(src_path, dest_path);
 		} else {
-			printf("[DEBUG] Copying file: %s\n", src_path);
-			FILE* src_file = fopen(src_path, "rb");
-			FILE* dest_file = fopen(dest_path, "wb");
-			if (src_file && dest_file) {
-				char buffer[4096];
-				size_t n;
-				while ((n = fread(buffer, 1, sizeof(buffer), src_file)) > 0) {
-					fwrite(buffer, 1, n, dest_file);
-				}
-				fclose(src_file);
-				fclose(dest_file);
-			} else {
-				if (!src_file) fprintf(stderr, "[ERROR] Failed to open source file: %s\n", src_path);
-				if (!dest_file) fprintf(stderr, "[ERROR] Failed to open destination file: %s\n", dest_path);
-			}
+			OutputStatus status = copy_output_file(src_path, dest_path);
+			printf("[DEBUG] Copying file (%s): %s\n", output_status_name(status), src_path);
 		}
 	}
 	closedir(dir);
@@ -138,3 +126,21 @@ int check_path_type(const char* path) {
 	// Path is a regular file or other type
 	return 1;
 }
+
+void file_stamp_from_stat(const struct stat* st, FileStamp* stamp) {
+	stamp->mtime_sec = st->st_mtim.tv_sec;
+	stamp->mtime_nsec = st->st_mtim.tv_nsec;
+	stamp->ctime_sec = st->st_ctim.tv_sec;
+	stamp->ctime_nsec = st->st_ctim.tv_nsec;
+	stamp->size = st->st_size;
+	stamp->inode = st->st_ino;
+}
+
+bool file_stamp_equal(const FileStamp* a, const FileStamp* b) {
+	if (a->inode == 0 || b->inode == 0) return false;
+
+	return a->inode == b->inode &&
+		a->size == b->size &&
+		a->mtime_sec == b->mtime_sec && a->mtime_nsec == b->mtime_nsec &&
+		a->ctime_sec == b->ctime_sec && a->ctime_nsec == b->ctime_nsec;
+}
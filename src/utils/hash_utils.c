@@ -7,13 +7,28 @@
 
 #define HASH_BUFFER_SIZE 4096
 
-char* generate_file_hash(const char* file_path) {
-	FILE* file = fopen(file_path, "rb");
-	if (!file) {
-		fprintf(stderr, "Error: Could not open file %s for hashing.\n", file_path);
+void digest_to_hex_string(const unsigned char* digest, char* hex_out) {
+	for (int i = 0; i < SHA256_BLOCK_SIZE; i++) {
+		sprintf(hex_out + (i * 2), "%02x", digest[i]);
+	}
+	hex_out[SHA256_BLOCK_SIZE * 2] = '\0';
+}
+
+static char* digest_to_hex(const BYTE* digest) {
+	char* hash_str = malloc(sizeof(char) * (SHA256_BLOCK_SIZE * 2 + 1));
+	if (!hash_str) {
+		fprintf(stderr, "Error: Memory allocation failed for hash string.\n");
 		return NULL;
 	}
 
+	digest_to_hex_string(digest, hash_str);
+	return hash_str;
+}
+
+bool generate_file_digest(const char* file_path, unsigned char* digest) {
+	FILE* file = fopen(file_path, "rb");
+	if (!file) return false;
+
 	SHA256_CTX ctx;
 	sha256_init(&ctx);
 
@@ -25,20 +40,45 @@ char* generate_file_hash(const char* file_path) {
 	}
 	fclose(file);
 
-	BYTE digest[SHA256_BLOCK_SIZE];
 	sha256_final(&ctx, digest);
+	return true;
+}
 
-	char* hash_str = malloc(sizeof(char) * (SHA256_BLOCK_SIZE * 2 + 1));
-	if (!hash_str) {
-		fprintf(stderr, "Error: Memory allocation failed for hash string.\n");
+char* generate_file_hash(const char* file_path) {
+	BYTE digest[SHA256_BLOCK_SIZE];
+	if (!generate_file_digest(file_path, digest)) {
+		fprintf(stderr, "Error: Could not open file %s for hashing.\n", file_path);
 		return NULL;
 	}
 
-	for (int i = 0; i < SHA256_BLOCK_SIZE; i++) {
-		sprintf(hash_str + (i * 2), "%02x", digest[i]);
-	}
+	return digest_to_hex(digest);
+}
 
-	hash_str[SHA256_BLOCK_SIZE * 2] = '\0';
+void generate_buffer_digest(const void* data, size_t length, unsigned char* digest) {
+	SHA256_CTX ctx;
+	sha256_init(&ctx);
+	sha256_update(&ctx, (const BYTE*)data, length);
+	sha256_final(&ctx, digest);
+}
 
-	return hash_str;
+char* generate_buffer_hash(const void* data, size_t length) {
+	BYTE digest[SHA256_BLOCK_SIZE];
+	generate_buffer_digest(data, length, digest);
+
+	return digest_to_hex(digest);
+}
+
+#define FNV_PRIME 1099511628211ULL
+
+uint64_t fnv1a_update(uint64_t hash, const void* data, size_t length) {
+	const unsigned char* bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < length; i++) {
+		hash ^= bytes[i];
+		hash *= FNV_PRIME;
+	}
+	return hash;
+}
+
+uint64_t fnv1a(const void* data, size_t length) {
+	return fnv1a_update(FNV_OFFSET_BASIS, data, length);
 }
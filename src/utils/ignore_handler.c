@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 
 #include "../include/ignore_handler.h"
 
@@ -9,6 +10,9 @@
 
 static char* ignore_patterns[MAX_IGNORE_PATTERNS];
 static int ignore_count = 0;
+// vault-relative directories the build itself uses, see ignore_directory()
+static char* ignored_directories[MAX_IGNORE_PATTERNS];
+static int ignored_directory_count = 0;
 
 void load_ssgignore(const char* base_path) {
 	char ssgignore_path[MAX_PATH_LENGTH];
@@ -27,12 +31,31 @@ void load_ssgignore(const char* base_path) {
 	fclose(file);
 }
 
+// A directory given relative to the working directory, like the output and
+// static directories, is ignored if it lies inside the vault.
+void ignore_directory(const char* base_path, const char* directory) {
+	char base[PATH_MAX];
+	char resolved[PATH_MAX];
+	if (!directory || !*directory || ignored_directory_count >= MAX_IGNORE_PATTERNS) return;
+	if (!realpath(base_path, base) || !realpath(directory, resolved)) return;
+
+	size_t base_len = strlen(base);
+	if (strncmp(resolved, base, base_len) != 0 || resolved[base_len] != '/') return;
+	ignored_directories[ignored_directory_count++] = strdup(resolved + base_len + 1);
+}
+
 bool is_ignored(const char* path) {
 	for (int i = 0; i < ignore_count; i++) {
 		if (strstr(path, ignore_patterns[i]) == path) {
 			return true;
 		}
 	}
+	for (int i = 0; i < ignored_directory_count; i++) {
+		size_t len = strlen(ignored_directories[i]);
+		if (strncmp(path, ignored_directories[i], len) == 0 && (path[len] == '\0' || path[len] == '/')) {
+			return true;
+		}
+	}
 	return false;
 }
 
@@ -40,5 +63,8 @@ void free_ignore_patterns() {
 	for (int i = 0; i < ignore_count; i++) {
 		free(ignore_patterns[i]);
 	}
+	for (int i = 0; i < ignored_directory_count; i++) {
+		free(ignored_directories[i]);
+	}
 }
 
@@ -0,0 +1,446 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "../include/link_resolver.h"
+#include "../include/site_context.h"
+#include "../include/html_generator.h"
+#include "../include/ignore_handler.h"
+
+#define HANGUL_S_BASE 0xAC00
+#define HANGUL_L_BASE 0x1100
+#define HANGUL_V_BASE 0x1161
+#define HANGUL_T_BASE 0x11A7
+#define HANGUL_L_COUNT 19
+#define HANGUL_V_COUNT 21
+#define HANGUL_T_COUNT 28
+#define HANGUL_S_COUNT (HANGUL_L_COUNT * HANGUL_V_COUNT * HANGUL_T_COUNT)
+
+typedef struct {
+	uint16_t base;
+	uint16_t mark;
+	uint16_t composed;
+} Composition;
+
+// Canonical compositions of the precomposed letters in U+00C0..U+017F
+// (Latin-1 and Latin Extended-A), sorted by base and mark.
+static const Composition latin_compositions[] = {
+	{ 0x0041, 0x0300, 0x00C0 }, { 0x0041, 0x0301, 0x00C1 }, { 0x0041, 0x0302, 0x00C2 }, { 0x0041, 0x0303, 0x00C3 },
+	{ 0x0041, 0x0304, 0x0100 }, { 0x0041, 0x0306, 0x0102 }, { 0x0041, 0x0308, 0x00C4 }, { 0x0041, 0x030A, 0x00C5 },
+	{ 0x0041, 0x0328, 0x0104 }, { 0x0043, 0x0301, 0x0106 }, { 0x0043, 0x0302, 0x0108 }, { 0x0043, 0x0307, 0x010A },
+	{ 0x0043, 0x030C, 0x010C }, { 0x0043, 0x0327, 0x00C7 }, { 0x0044, 0x030C, 0x010E }, { 0x0045, 0x0300, 0x00C8 },
+	{ 0x0045, 0x0301, 0x00C9 }, { 0x0045, 0x0302, 0x00CA }, { 0x0045, 0x0304, 0x0112 }, { 0x0045, 0x0306, 0x0114 },
+	{ 0x0045, 0x0307, 0x0116 }, { 0x0045, 0x0308, 0x00CB }, { 0x0045, 0x030C, 0x011A }, { 0x0045, 0x0328, 0x0118 },
+	{ 0x0047, 0x0302, 0x011C }, { 0x0047, 0x0306, 0x011E }, { 0x0047, 0x0307, 0x0120 }, { 0x0047, 0x0327, 0x0122 },
+	{ 0x0048, 0x0302, 0x0124 }, { 0x0049, 0x0300, 0x00CC }, { 0x0049, 0x0301, 0x00CD }, { 0x0049, 0x0302, 0x00CE },
+	{ 0x0049, 0x0303, 0x0128 }, { 0x0049, 0x0304, 0x012A }, { 0x0049, 0x0306, 0x012C }, { 0x0049, 0x0307, 0x0130 },
+	{ 0x0049, 0x0308, 0x00CF }, { 0x0049, 0x0328, 0x012E }, { 0x004A, 0x0302, 0x0134 }, { 0x004B, 0x0327, 0x0136 },
+	{ 0x004C, 0x0301, 0x0139 }, { 0x004C, 0x030C, 0x013D }, { 0x004C, 0x0327, 0x013B }, { 0x004E, 0x0301, 0x0143 },
+	{ 0x004E, 0x0303, 0x00D1 }, { 0x004E, 0x030C, 0x0147 }, { 0x004E, 0x0327, 0x0145 }, { 0x004F, 0x0300, 0x00D2 },
+	{ 0x004F, 0x0301, 0x00D3 }, { 0x004F, 0x0302, 0x00D4 }, { 0x004F, 0x0303, 0x00D5 }, { 0x004F, 0x0304, 0x014C },
+	{ 0x004F, 0x0306, 0x014E }, { 0x004F, 0x0308, 0x00D6 }, { 0x004F, 0x030B, 0x0150 }, { 0x0052, 0x0301, 0x0154 },
+	{ 0x0052, 0x030C, 0x0158 }, { 0x0052, 0x0327, 0x0156 }, { 0x0053, 0x0301, 0x015A }, { 0x0053, 0x0302, 0x015C },
+	{ 0x0053, 0x030C, 0x0160 }, { 0x0053, 0x0327, 0x015E }, { 0x0054, 0x030C, 0x0164 }, { 0x0054, 0x0327, 0x0162 },
+	{ 0x0055, 0x0300, 0x00D9 }, { 0x0055, 0x0301, 0x00DA }, { 0x0055, 0x0302, 0x00DB }, { 0x0055, 0x0303, 0x0168 },
+	{ 0x0055, 0x0304, 0x016A }, { 0x0055, 0x0306, 0x016C }, { 0x0055, 0x0308, 0x00DC }, { 0x0055, 0x030A, 0x016E },
+	{ 0x0055, 0x030B, 0x0170 }, { 0x0055, 0x0328, 0x0172 }, { 0x0057, 0x0302, 0x0174 }, { 0x0059, 0x0301, 0x00DD },
+	{ 0x0059, 0x0302, 0x0176 }, { 0x0059, 0x0308, 0x0178 }, { 0x005A, 0x0301, 0x0179 }, { 0x005A, 0x0307, 0x017B },
+	{ 0x005A, 0x030C, 0x017D }, { 0x0061, 0x0300, 0x00E0 }, { 0x0061, 0x0301, 0x00E1 }, { 0x0061, 0x0302, 0x00E2 },
+	{ 0x0061, 0x0303, 0x00E3 }, { 0x0061, 0x0304, 0x0101 }, { 0x0061, 0x0306, 0x0103 }, { 0x0061, 0x0308, 0x00E4 },
+	{ 0x0061, 0x030A, 0x00E5 }, { 0x0061, 0x0328, 0x0105 }, { 0x0063, 0x0301, 0x0107 }, { 0x0063, 0x0302, 0x0109 },
+	{ 0x0063, 0x0307, 0x010B }, { 0x0063, 0x030C, 0x010D }, { 0x0063, 0x0327, 0x00E7 }, { 0x0064, 0x030C, 0x010F },
+	{ 0x0065, 0x0300, 0x00E8 }, { 0x0065, 0x0301, 0x00E9 }, { 0x0065, 0x0302, 0x00EA }, { 0x0065, 0x0304, 0x0113 },
+	{ 0x0065, 0x0306, 0x0115 }, { 0x0065, 0x0307, 0x0117 }, { 0x0065, 0x0308, 0x00EB }, { 0x0065, 0x030C, 0x011B },
+	{ 0x0065, 0x0328, 0x0119 }, { 0x0067, 0x0302, 0x011D }, { 0x0067, 0x0306, 0x011F }, { 0x0067, 0x0307, 0x0121 },
+	{ 0x0067, 0x0327, 0x0123 }, { 0x0068, 0x0302, 0x0125 }, { 0x0069, 0x0300, 0x00EC }, { 0x0069, 0x0301, 0x00ED },
+	{ 0x0069, 0x0302, 0x00EE }, { 0x0069, 0x0303, 0x0129 }, { 0x0069, 0x0304, 0x012B }, { 0x0069, 0x0306, 0x012D },
+	{ 0x0069, 0x0308, 0x00EF }, { 0x0069, 0x0328, 0x012F }, { 0x006A, 0x0302, 0x0135 }, { 0x006B, 0x0327, 0x0137 },
+	{ 0x006C, 0x0301, 0x013A }, { 0x006C, 0x030C, 0x013E }, { 0x006C, 0x0327, 0x013C }, { 0x006E, 0x0301, 0x0144 },
+	{ 0x006E, 0x0303, 0x00F1 }, { 0x006E, 0x030C, 0x0148 }, { 0x006E, 0x0327, 0x0146 }, { 0x006F, 0x0300, 0x00F2 },
+	{ 0x006F, 0x0301, 0x00F3 }, { 0x006F, 0x0302, 0x00F4 }, { 0x006F, 0x0303, 0x00F5 }, { 0x006F, 0x0304, 0x014D },
+	{ 0x006F, 0x0306, 0x014F }, { 0x006F, 0x0308, 0x00F6 }, { 0x006F, 0x030B, 0x0151 }, { 0x0072, 0x0301, 0x0155 },
+	{ 0x0072, 0x030C, 0x0159 }, { 0x0072, 0x0327, 0x0157 }, { 0x0073, 0x0301, 0x015B }, { 0x0073, 0x0302, 0x015D },
+	{ 0x0073, 0x030C, 0x0161 }, { 0x0073, 0x0327, 0x015F }, { 0x0074, 0x030C, 0x0165 }, { 0x0074, 0x0327, 0x0163 },
+	{ 0x0075, 0x0300, 0x00F9 }, { 0x0075, 0x0301, 0x00FA }, { 0x0075, 0x0302, 0x00FB }, { 0x0075, 0x0303, 0x0169 },
+	{ 0x0075, 0x0304, 0x016B }, { 0x0075, 0x0306, 0x016D }, { 0x0075, 0x0308, 0x00FC }, { 0x0075, 0x030A, 0x016F },
+	{ 0x0075, 0x030B, 0x0171 }, { 0x0075, 0x0328, 0x0173 }, { 0x0077, 0x0302, 0x0175 }, { 0x0079, 0x0301, 0x00FD },
+	{ 0x0079, 0x0302, 0x0177 }, { 0x0079, 0x0308, 0x00FF }, { 0x007A, 0x0301, 0x017A }, { 0x007A, 0x0307, 0x017C },
+	{ 0x007A, 0x030C, 0x017E },
+};
+
+typedef enum {
+	RANK_PATH,
+	RANK_NAME,
+	RANK_ALIAS,
+} KeyRank;
+
+// One key a target is reachable under, before collisions are settled.
+typedef struct {
+	char* key;
+	KeyRank rank;
+	bool is_directory;
+	const char* path;
+	size_t target;
+} KeyCandidate;
+
+typedef struct {
+	LinkTarget* targets;
+	size_t target_count;
+	size_t target_capacity;
+	KeyCandidate* candidates;
+	size_t candidate_count;
+	size_t candidate_capacity;
+} ResolverBuilder;
+
+static int compare_composition(const void* a, const void* b) {
+	const Composition* x = (const Composition*)a;
+	const Composition* y = (const Composition*)b;
+	if (x->base != y->base) return x->base < y->base ? -1 : 1;
+	if (x->mark != y->mark) return x->mark < y->mark ? -1 : 1;
+	return 0;
+}
+
+// The canonical composition of the pair, 0 if there is none.
+static uint32_t compose_pair(uint32_t first, uint32_t second) {
+	if (first - HANGUL_L_BASE < HANGUL_L_COUNT && second - HANGUL_V_BASE < HANGUL_V_COUNT) {
+		return HANGUL_S_BASE + ((first - HANGUL_L_BASE) * HANGUL_V_COUNT + (second - HANGUL_V_BASE)) * HANGUL_T_COUNT;
+	}
+	if (first - HANGUL_S_BASE < HANGUL_S_COUNT && (first - HANGUL_S_BASE) % HANGUL_T_COUNT == 0
+			&& second - HANGUL_T_BASE - 1 < HANGUL_T_COUNT - 1) {
+		return first + (second - HANGUL_T_BASE);
+	}
+	if (first > 0xFFFF || second < 0x0300 || second > 0x036F) return 0;
+
+	Composition key = { (uint16_t)first, (uint16_t)second, 0 };
+	const Composition* found = bsearch(&key, latin_compositions, sizeof(latin_compositions) / sizeof(latin_compositions[0]),
+			sizeof(Composition), compare_composition);
+	return found ? found->composed : 0;
+}
+
+// Simple lower case of the basic Latin, Greek and Cyrillic alphabets. Every
+// mapping keeps the UTF-8 length, so keys never grow.
+static uint32_t to_lower(uint32_t cp) {
+	if (cp >= 'A' && cp <= 'Z') return cp + 0x20;
+	if (cp < 0xC0) return cp;
+	if (cp <= 0xDE) return cp == 0xD7 ? cp : cp + 0x20;
+	if (cp >= 0x100 && cp <= 0x17F) {
+		if (cp == 0x130 || cp == 0x131 || cp == 0x138 || cp == 0x149 || cp == 0x17F) return cp;
+		if (cp == 0x178) return 0xFF;
+		if ((cp >= 0x139 && cp <= 0x148) || (cp >= 0x179 && cp <= 0x17E)) return cp % 2 == 1 ? cp + 1 : cp;
+		return cp % 2 == 0 ? cp + 1 : cp;
+	}
+	if (cp >= 0x391 && cp <= 0x3AB && cp != 0x3A2) return cp + 0x20;
+	if (cp >= 0x410 && cp <= 0x42F) return cp + 0x20;
+	if (cp >= 0x400 && cp <= 0x40F) return cp + 0x50;
+	return cp;
+}
+
+// Length of the UTF-8 sequence at s, 0 if it is malformed.
+static size_t decode_utf8(const unsigned char* s, uint32_t* cp) {
+	if (s[0] < 0x80) {
+		*cp = s[0];
+		return 1;
+	}
+	if ((s[0] & 0xE0) == 0xC0 && (s[1] & 0xC0) == 0x80) {
+		*cp = ((uint32_t)(s[0] & 0x1F) << 6) | (s[1] & 0x3F);
+		return *cp >= 0x80 ? 2 : 0;
+	}
+	if ((s[0] & 0xF0) == 0xE0 && (s[1] & 0xC0) == 0x80 && (s[2] & 0xC0) == 0x80) {
+		*cp = ((uint32_t)(s[0] & 0x0F) << 12) | ((uint32_t)(s[1] & 0x3F) << 6) | (s[2] & 0x3F);
+		return *cp >= 0x800 ? 3 : 0;
+	}
+	if ((s[0] & 0xF8) == 0xF0 && (s[1] & 0xC0) == 0x80 && (s[2] & 0xC0) == 0x80 && (s[3] & 0xC0) == 0x80) {
+		*cp = ((uint32_t)(s[0] & 0x07) << 18) | ((uint32_t)(s[1] & 0x3F) << 12) | ((uint32_t)(s[2] & 0x3F) << 6) | (s[3] & 0x3F);
+		return *cp >= 0x10000 && *cp <= 0x10FFFF ? 4 : 0;
+	}
+	return 0;
+}
+
+static size_t encode_utf8(uint32_t cp, char* out) {
+	if (cp < 0x80) {
+		out[0] = (char)cp;
+		return 1;
+	}
+	if (cp < 0x800) {
+		out[0] = (char)(0xC0 | (cp >> 6));
+		out[1] = (char)(0x80 | (cp & 0x3F));
+		return 2;
+	}
+	if (cp < 0x10000) {
+		out[0] = (char)(0xE0 | (cp >> 12));
+		out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+		out[2] = (char)(0x80 | (cp & 0x3F));
+		return 3;
+	}
+	out[0] = (char)(0xF0 | (cp >> 18));
+	out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+	out[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+	out[3] = (char)(0x80 | (cp & 0x3F));
+	return 4;
+}
+
+// Each code point is held back until the next one shows whether the two
+// compose. Malformed bytes are copied as they are.
+size_t normalize_link_key(const char* text, char* out) {
+	const unsigned char* s = (const unsigned char*)text;
+	size_t length = 0;
+	uint32_t pending = 0;
+	bool has_pending = false;
+
+	while (*s) {
+		uint32_t cp;
+		size_t n = decode_utf8(s, &cp);
+		if (n == 0) {
+			if (has_pending) length += encode_utf8(to_lower(pending), out + length);
+			has_pending = false;
+			out[length++] = (char)*s++;
+			continue;
+		}
+		s += n;
+
+		uint32_t composed = has_pending ? compose_pair(pending, cp) : 0;
+		if (composed) {
+			pending = composed;
+			continue;
+		}
+		if (has_pending) length += encode_utf8(to_lower(pending), out + length);
+		pending = cp;
+		has_pending = true;
+	}
+	if (has_pending) length += encode_utf8(to_lower(pending), out + length);
+	out[length] = '\0';
+
+	if (length >= 3 && strcmp(out + length - 3, ".md") == 0) {
+		length -= 3;
+		out[length] = '\0';
+	}
+	return length;
+}
+
+static bool is_note(const NavNode* node) {
+	size_t name_len = strlen(node->name);
+	return !node->is_directory && name_len > 3 && strcmp(node->name + name_len - 3, ".md") == 0;
+}
+
+static char* build_target_url(const NavNode* node) {
+	const char* path = is_note(node) ? node->slug : node->output_path;
+	char* url = malloc(strlen(path) + 2);
+	sprintf(url, "/%s", path);
+	return url;
+}
+
+static void add_candidate(ResolverBuilder* builder, const char* text, KeyRank rank, size_t target) {
+	char* key = malloc(strlen(text) + 1);
+	if (normalize_link_key(text, key) == 0) {
+		free(key);
+		return;
+	}
+
+	if (builder->candidate_count == builder->candidate_capacity) {
+		builder->candidate_capacity = builder->candidate_capacity ? builder->candidate_capacity * 2 : 256;
+		builder->candidates = realloc(builder->candidates, builder->candidate_capacity * sizeof(KeyCandidate));
+	}
+	const NavNode* node = builder->targets[target].node;
+	builder->candidates[builder->candidate_count++] = (KeyCandidate){
+		.key = key,
+		.rank = rank,
+		.is_directory = node->is_directory,
+		.path = node->full_path,
+		.target = target,
+	};
+}
+
+static void add_target(ResolverBuilder* builder, NavNode* node) {
+	if (builder->target_count == builder->target_capacity) {
+		builder->target_capacity = builder->target_capacity ? builder->target_capacity * 2 : 256;
+		builder->targets = realloc(builder->targets, builder->target_capacity * sizeof(LinkTarget));
+	}
+	size_t target = builder->target_count++;
+	builder->targets[target] = (LinkTarget){ .node = node, .url = build_target_url(node) };
+	generate_buffer_digest(builder->targets[target].url, strlen(builder->targets[target].url), builder->targets[target].url_digest);
+
+	add_candidate(builder, node->full_path, RANK_PATH, target);
+	add_candidate(builder, node->name, RANK_NAME, target);
+
+	// front matter aliases, one per line
+	if (node->meta.aliases) {
+		char* aliases = strdup(node->meta.aliases);
+		char* saveptr = NULL;
+		for (char* alias = strtok_r(aliases, "\n", &saveptr); alias; alias = strtok_r(NULL, "\n", &saveptr)) {
+			add_candidate(builder, alias, RANK_ALIAS, target);
+		}
+		free(aliases);
+	}
+}
+
+// Ignored paths, the output and static directories among them, are not link targets.
+static void collect_targets(ResolverBuilder* builder, NavNode* parent) {
+	NavNode* child;
+	list_for_each_entry(child, &parent->children, sibling) {
+		if (is_ignored(child->full_path)) continue;
+		add_target(builder, child);
+		if (child->is_directory) {
+			collect_targets(builder, child);
+		}
+	}
+}
+
+// Orders each key's candidates best first, independent of readdir order.
+static int compare_candidates(const void* a, const void* b) {
+	const KeyCandidate* x = (const KeyCandidate*)a;
+	const KeyCandidate* y = (const KeyCandidate*)b;
+	int by_key = strcmp(x->key, y->key);
+	if (by_key != 0) return by_key;
+	if (x->rank != y->rank) return x->rank < y->rank ? -1 : 1;
+	if (x->is_directory != y->is_directory) return x->is_directory ? 1 : -1;
+
+	size_t x_len = strlen(x->path), y_len = strlen(y->path);
+	if (x_len != y_len) return x_len < y_len ? -1 : 1;
+	return strcmp(x->path, y->path);
+}
+
+static void add_ambiguity(LinkResolver* resolver, const char* key, const LinkTarget* chosen, const LinkTarget* other) {
+	resolver->ambiguities = realloc(resolver->ambiguities, (resolver->ambiguity_count + 1) * sizeof(LinkAmbiguity));
+	resolver->ambiguities[resolver->ambiguity_count++] = (LinkAmbiguity){
+		.key = strdup(key),
+		.chosen = chosen,
+		.other = other,
+	};
+}
+
+LinkResolver* create_link_resolver(NavNode* root) {
+	ResolverBuilder builder = { 0 };
+	collect_targets(&builder, root);
+	qsort(builder.candidates, builder.candidate_count, sizeof(KeyCandidate), compare_candidates);
+
+	LinkResolver* resolver = calloc(1, sizeof(LinkResolver));
+	resolver->targets = builder.targets;
+	resolver->target_count = builder.target_count;
+	resolver->keys = ht_create(builder.candidate_count > 0 ? builder.candidate_count : 1);
+	resolver->by_path = ht_create(builder.target_count > 0 ? builder.target_count : 1);
+	resolver->anchors = ht_create(builder.target_count > 0 ? builder.target_count * 4 : 1);
+	for (size_t k = 0; k < resolver->target_count; k++) {
+		ht_set(resolver->by_path, resolver->targets[k].node->full_path, &resolver->targets[k]);
+	}
+
+	// the first candidate of every key wins; others of the same rank are reported
+	size_t i = 0;
+	while (i < builder.candidate_count) {
+		const KeyCandidate* winner = &builder.candidates[i];
+		const LinkTarget* chosen = &resolver->targets[winner->target];
+		ht_set(resolver->keys, winner->key, (void*)chosen);
+
+		size_t j = i + 1;
+		for (; j < builder.candidate_count && strcmp(builder.candidates[j].key, winner->key) == 0; j++) {
+			const KeyCandidate* rival = &builder.candidates[j];
+			if (rival->rank != winner->rank || rival->is_directory != winner->is_directory) continue;
+			if (rival->target == winner->target || rival->target == builder.candidates[j - 1].target) continue;
+			add_ambiguity(resolver, winner->key, chosen, &resolver->targets[rival->target]);
+		}
+		i = j;
+	}
+
+	for (size_t k = 0; k < builder.candidate_count; k++) {
+		free(builder.candidates[k].key);
+	}
+	free(builder.candidates);
+	return resolver;
+}
+
+static void free_link_anchor(void* value) {
+	LinkAnchor* anchor = value;
+	free(anchor->url);
+	free(anchor);
+}
+
+void free_link_resolver(LinkResolver* resolver) {
+	if (!resolver) return;
+	ht_destroy(resolver->keys, NULL);
+	ht_destroy(resolver->by_path, NULL);
+	ht_destroy(resolver->anchors, free_link_anchor);
+	for (size_t i = 0; i < resolver->target_count; i++) {
+		free(resolver->targets[i].url);
+	}
+	free(resolver->targets);
+	for (size_t i = 0; i < resolver->ambiguity_count; i++) {
+		free(resolver->ambiguities[i].key);
+	}
+	free(resolver->ambiguities);
+	free(resolver);
+}
+
+const char* find_link_fragment(const char* link_target) {
+	// Obsidian does not allow either character in a note name
+	return strpbrk(link_target, "#^");
+}
+
+const LinkTarget* resolve_link_target(const LinkResolver* resolver, const char* link_target) {
+	const char* fragment = find_link_fragment(link_target);
+	size_t length = fragment ? (size_t)(fragment - link_target) : strlen(link_target);
+	char stack_key[512];
+	char* name = length < sizeof(stack_key) / 2 ? stack_key : malloc(2 * (length + 1));
+	char* key = name + length + 1;
+
+	memcpy(name, link_target, length);
+	name[length] = '\0';
+	normalize_link_key(name, key);
+	const LinkTarget* target = (const LinkTarget*)ht_get(resolver->keys, key);
+
+	if (name != stack_key) free(name);
+	return target;
+}
+
+static char* anchored_url(const LinkTarget* target, const char* anchor_id) {
+	size_t url_length = strlen(target->url);
+	size_t id_length = strlen(anchor_id);
+	char* url = malloc(url_length + id_length + 2);
+	memcpy(url, target->url, url_length);
+	url[url_length] = '#';
+	memcpy(url + url_length + 1, anchor_id, id_length + 1);
+	return url;
+}
+
+void add_link_anchor(LinkResolver* resolver, const LinkTarget* target, const char* anchor_id) {
+	char* url = anchored_url(target, anchor_id);
+	if (ht_get(resolver->anchors, url)) {
+		free(url); // a repeated heading; its page has the id twice as well
+		return;
+	}
+	LinkAnchor* anchor = malloc(sizeof(LinkAnchor));
+	anchor->url = url;
+	generate_buffer_digest(url, strlen(url), anchor->url_digest);
+	ht_set(resolver->anchors, url, anchor);
+}
+
+const LinkAnchor* resolve_link_anchor(const LinkResolver* resolver, const LinkTarget* target, const char* fragment) {
+	if (!fragment) return NULL;
+
+	// "#^id" and "^id" name a block, whose page id has no caret; of "#a#b"
+	// only the innermost heading counts
+	char* anchor_id;
+	if (fragment[0] == '^' || fragment[1] == '^') {
+		anchor_id = strdup(fragment[0] == '^' ? fragment + 1 : fragment + 2);
+	} else {
+		anchor_id = generate_anchor_id(strrchr(fragment, '#') + 1);
+	}
+
+	char* url = anchored_url(target, anchor_id);
+	const LinkAnchor* found = (const LinkAnchor*)ht_get(resolver->anchors, url);
+	free(url);
+	free(anchor_id);
+	return found;
+}
+
+const LinkTarget* link_target_of_node(const LinkResolver* resolver, const NavNode* node) {
+	return (const LinkTarget*)ht_get(resolver->by_path, node->full_path);
+}
+
+void report_link_ambiguities(const LinkResolver* resolver) {
+	for (size_t i = 0; i < resolver->ambiguity_count; i++) {
+		const LinkAmbiguity* ambiguity = &resolver->ambiguities[i];
+		fprintf(stderr, "Warning: '[[%s]]' matches both '%s' (used) and '%s'\n",
+				ambiguity->key, ambiguity->chosen->node->full_path, ambiguity->other->node->full_path);
+	}
+}
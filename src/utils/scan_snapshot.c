@@ -0,0 +1,263 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "../include/scan_snapshot.h"
+#include "../include/cache_manager.h"
+#include "../include/dynamic_buffer.h"
+#include "../include/hash_utils.h"
+
+/*
+ * File layout (native byte order):
+ *
+ *   SnapshotFileHeader
+ *   directory_count times:
+ *     uint32_t path_length, char path[path_length]
+ *     SnapshotStamp stamp
+ *     uint32_t entry_count
+ *     entry_count times: uint8_t is_directory, uint32_t name_length, char name[name_length]
+ */
+typedef struct {
+	char magic[8];
+	uint32_t version;
+	uint32_t directory_count;
+	uint64_t body_size;
+	uint8_t digest[HASH_DIGEST_SIZE]; // SHA-256 of the body
+} SnapshotFileHeader;
+
+typedef struct {
+	int64_t mtime_sec;
+	int64_t mtime_nsec;
+	int64_t ctime_sec;
+	int64_t ctime_nsec;
+	int64_t size;
+	uint64_t inode;
+} SnapshotStamp;
+
+static void get_snapshot_path(char* buffer, size_t size, const char* suffix) {
+	snprintf(buffer, size, "%s/%s%s", CACHE_DIR, SCAN_SNAPSHOT_FILE, suffix);
+}
+
+ScanSnapshot* create_scan_snapshot() {
+	ScanSnapshot* snapshot = malloc(sizeof(ScanSnapshot));
+	snapshot->directories = ht_create(256);
+	snapshot->directory_count = 0;
+	return snapshot;
+}
+
+static void free_directory_snapshot(void* value) {
+	DirectorySnapshot* directory = (DirectorySnapshot*)value;
+	for (size_t i = 0; i < directory->count; i++) {
+		free(directory->entries[i].name);
+	}
+	free(directory->entries);
+	free(directory);
+}
+
+void free_scan_snapshot(ScanSnapshot* snapshot) {
+	if (!snapshot) return;
+	ht_destroy(snapshot->directories, free_directory_snapshot);
+	free(snapshot);
+}
+
+const DirectorySnapshot* find_directory_snapshot(const ScanSnapshot* snapshot, const char* path, const FileStamp* stamp) {
+	if (!snapshot) return NULL;
+
+	const DirectorySnapshot* directory = (const DirectorySnapshot*)ht_get(snapshot->directories, path);
+	if (!directory || !file_stamp_equal(&directory->stamp, stamp)) return NULL;
+	return directory;
+}
+
+DirectorySnapshot* add_directory_snapshot(ScanSnapshot* snapshot, const char* path, const FileStamp* stamp) {
+	DirectorySnapshot* directory = calloc(1, sizeof(DirectorySnapshot));
+	directory->stamp = *stamp;
+
+	DirectorySnapshot* previous = (DirectorySnapshot*)ht_get(snapshot->directories, path);
+	if (previous) {
+		free_directory_snapshot(previous);
+	} else {
+		snapshot->directory_count++;
+	}
+	ht_set(snapshot->directories, path, directory);
+	return directory;
+}
+
+void directory_snapshot_add_entry(DirectorySnapshot* directory, const char* name, bool is_directory) {
+	if (directory->count == directory->capacity) {
+		directory->capacity = directory->capacity ? directory->capacity * 2 : 16;
+		directory->entries = realloc(directory->entries, directory->capacity * sizeof(SnapshotEntry));
+	}
+
+	SnapshotEntry* entry = &directory->entries[directory->count++];
+	entry->name = strdup(name);
+	entry->is_directory = is_directory;
+}
+
+static void append_string(DynamicBuffer* buffer, const char* str) {
+	uint32_t length = (uint32_t)strlen(str);
+	buffer_append_bytes(buffer, &length, sizeof(length));
+	buffer_append_bytes(buffer, str, length);
+}
+
+static void serialize_directory(DynamicBuffer* body, const char* path, const DirectorySnapshot* directory) {
+	SnapshotStamp stamp = {
+		.mtime_sec = directory->stamp.mtime_sec,
+		.mtime_nsec = directory->stamp.mtime_nsec,
+		.ctime_sec = directory->stamp.ctime_sec,
+		.ctime_nsec = directory->stamp.ctime_nsec,
+		.size = directory->stamp.size,
+		.inode = directory->stamp.inode,
+	};
+	uint32_t entry_count = (uint32_t)directory->count;
+
+	append_string(body, path);
+	buffer_append_bytes(body, &stamp, sizeof(stamp));
+	buffer_append_bytes(body, &entry_count, sizeof(entry_count));
+	for (size_t i = 0; i < directory->count; i++) {
+		uint8_t is_directory = directory->entries[i].is_directory;
+		buffer_append_bytes(body, &is_directory, sizeof(is_directory));
+		append_string(body, directory->entries[i].name);
+	}
+}
+
+void save_scan_snapshot(const ScanSnapshot* snapshot) {
+	if (!snapshot) return;
+
+	DynamicBuffer* body = create_dynamic_buffer(4096);
+	for (size_t i = 0; i < snapshot->directories->size; i++) {
+		for (HashEntry* entry = snapshot->directories->entries[i]; entry; entry = entry->next) {
+			serialize_directory(body, entry->key, (const DirectorySnapshot*)entry->value);
+		}
+	}
+
+	SnapshotFileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, SCAN_SNAPSHOT_MAGIC, sizeof(header.magic));
+	header.version = SCAN_SNAPSHOT_VERSION;
+	header.directory_count = (uint32_t)snapshot->directory_count;
+	header.body_size = body->length;
+	generate_buffer_digest(body->content, body->length, header.digest);
+
+	char snapshot_path[256];
+	char temp_path[256];
+	get_snapshot_path(snapshot_path, sizeof(snapshot_path), "");
+	get_snapshot_path(temp_path, sizeof(temp_path), ".tmp");
+
+	FILE* file = fopen(temp_path, "wb");
+	if (!file) {
+		fprintf(stderr, "Error: Could not open scan snapshot for writing: %s\n", temp_path);
+	} else {
+		bool ok = fwrite(&header, 1, sizeof(header), file) == sizeof(header);
+		ok = ok && (body->length == 0 || fwrite(body->content, 1, body->length, file) == body->length);
+		ok = (fflush(file) == 0) && ok;
+		ok = (fsync(fileno(file)) == 0) && ok;
+		ok = (fclose(file) == 0) && ok;
+
+		if (!ok || rename(temp_path, snapshot_path) != 0) {
+			fprintf(stderr, "Error: Failed to write scan snapshot: %s\n", snapshot_path);
+			remove(temp_path);
+		}
+	}
+
+	free(destroy_buffer_and_get_content(body));
+}
+
+typedef struct {
+	const char* cursor;
+	const char* end;
+} SnapshotReader;
+
+static bool read_bytes(SnapshotReader* reader, void* out, size_t length) {
+	if ((size_t)(reader->end - reader->cursor) < length) return false;
+	memcpy(out, reader->cursor, length);
+	reader->cursor += length;
+	return true;
+}
+
+static char* read_string(SnapshotReader* reader) {
+	uint32_t length;
+	if (!read_bytes(reader, &length, sizeof(length))) return NULL;
+	if ((size_t)(reader->end - reader->cursor) < length) return NULL;
+
+	char* str = strndup(reader->cursor, length);
+	reader->cursor += length;
+	return str;
+}
+
+static bool parse_directory(SnapshotReader* reader, ScanSnapshot* snapshot) {
+	char* path = read_string(reader);
+	if (!path) return false;
+
+	SnapshotStamp raw;
+	uint32_t entry_count;
+	if (!read_bytes(reader, &raw, sizeof(raw)) || !read_bytes(reader, &entry_count, sizeof(entry_count))) {
+		free(path);
+		return false;
+	}
+
+	FileStamp stamp = {
+		.mtime_sec = raw.mtime_sec,
+		.mtime_nsec = raw.mtime_nsec,
+		.ctime_sec = raw.ctime_sec,
+		.ctime_nsec = raw.ctime_nsec,
+		.size = raw.size,
+		.inode = raw.inode,
+	};
+	DirectorySnapshot* directory = add_directory_snapshot(snapshot, path, &stamp);
+	free(path);
+
+	for (uint32_t i = 0; i < entry_count; i++) {
+		uint8_t is_directory;
+		if (!read_bytes(reader, &is_directory, sizeof(is_directory))) return false;
+
+		char* name = read_string(reader);
+		if (!name) return false;
+		directory_snapshot_add_entry(directory, name, is_directory != 0);
+		free(name);
+	}
+	return true;
+}
+
+// Returns an empty snapshot when the file is missing, outdated or corrupted.
+ScanSnapshot* load_scan_snapshot() {
+	ScanSnapshot* snapshot = create_scan_snapshot();
+
+	char snapshot_path[256];
+	get_snapshot_path(snapshot_path, sizeof(snapshot_path), "");
+
+	FILE* file = fopen(snapshot_path, "rb");
+	if (!file) return snapshot;
+
+	SnapshotFileHeader header;
+	char* body = NULL;
+	bool ok = fread(&header, 1, sizeof(header), file) == sizeof(header)
+		&& memcmp(header.magic, SCAN_SNAPSHOT_MAGIC, sizeof(header.magic)) == 0
+		&& header.version == SCAN_SNAPSHOT_VERSION;
+
+	if (ok) {
+		body = malloc(header.body_size ? header.body_size : 1);
+		ok = body && fread(body, 1, header.body_size, file) == header.body_size && fgetc(file) == EOF;
+	}
+	fclose(file);
+
+	if (ok) {
+		unsigned char digest[HASH_DIGEST_SIZE];
+		generate_buffer_digest(body, header.body_size, digest);
+		ok = memcmp(digest, header.digest, HASH_DIGEST_SIZE) == 0;
+	}
+
+	SnapshotReader reader = { body, body + (ok ? header.body_size : 0) };
+	for (uint32_t i = 0; ok && i < header.directory_count; i++) {
+		ok = parse_directory(&reader, snapshot);
+	}
+	free(body);
+
+	if (!ok || reader.cursor != reader.end) {
+		fprintf(stderr, "Warning: Scan snapshot '%s' is outdated or corrupted. Listing every directory.\n", snapshot_path);
+		free_scan_snapshot(snapshot);
+		return create_scan_snapshot();
+	}
+	return snapshot;
+}
@@ -5,15 +5,25 @@
 #include <dirent.h>
 #include <stdbool.h>
 #include <ctype.h>
+#include <time.h>
 
 #include "../include/site_context.h"
 #include "../include/dynamic_buffer.h"
 #include "../include/ignore_handler.h"
+#include "../include/hash_utils.h"
 
 #define MAX_PATH_LENGTH 1024
-#define EXCERPT_TARGET_LEN 150
 
-static void scan_recursively(NavNode* parent, HashTable* name_lookup, HashTable* path_lookup, const char* base_path, const char* current_subpath);
+typedef struct {
+	HashTable* path_lookup;
+	const char* base_path;
+	const BuildCache* cache;             // may be NULL
+	const ScanSnapshot* previous;        // may be NULL
+	ScanSnapshot* snapshot;
+	time_t started_at;
+} ScanState;
+
+static void scan_recursively(NavNode* parent, const FileStamp* dir_stamp, ScanState* state, const char* current_subpath);
 static void build_sidebar_html_recursively(NavNode* node, DynamicBuffer* buffer, const char* base_url, TemplateContext* context);
 
 static NavNode* create_nav_node(const char* name, const char* path, bool is_dir) {
@@ -22,7 +32,11 @@ static NavNode* create_nav_node(const char* name, const char* path, bool is_dir)
 	node->full_path = strdup(path);
 	node->is_directory = is_dir;
 	node->slug = NULL;
-	node->excerpt = NULL;
+	memset(&node->meta, 0, sizeof(NoteMetadata));
+	memset(&node->stamp, 0, sizeof(FileStamp));
+	node->source = NULL;
+	node->has_source_digest = false;
+	memset(node->tree_digest, 0, HASH_DIGEST_SIZE);
 
 	char output_path_buffer[MAX_PATH_LENGTH];
 	strcpy(output_path_buffer, path);
@@ -53,101 +67,39 @@ static void free_nav_node_recursively(NavNode* node) {
 	free(node->full_path);
 	free(node->output_path);
 	free(node->slug);
-	free(node->excerpt);
+	free_note_metadata(&node->meta);
+	free_source_document(node->source);
 	free(node);
 }
 
-static char* extract_excerpt_from_file(const char* file_path) {
-	FILE *file = fopen(file_path, "r");
-	if (!file) return NULL;
-
-	char line[MAX_PATH_LENGTH];
-
-	// Skipping Frontmatter
-	if (fgets(line, sizeof(line), file) && strncmp(line, "---", 3) == 0) {
-		while (fgets(line, sizeof(line), file)) {
-			if (strncmp(line, "---", 3) == 0) break;
-		}
-	} else {
-		// if no frontmatter detected, rewind to start
-		fseek(file, 0, SEEK_SET);
-	}
-
-	char excerpt_buffer[MAX_PATH_LENGTH] = {0};
-	int current_len = 0;
-
-	while (fgets(line, sizeof(line), file)) {
-		char* p = line;
-		
-		// ignore markdown grammer, whitespaces
-		while (*p && (isspace((unsigned char)*p) || *p == '-' || *p == '*' || *p == '>')) {
-			p++;
-		}
-		
-		if (*p == '\0') continue;
-		
-		if (p[0] == '#') continue; 
-		if (strncmp(p, "이전 글:", strlen("이전 글:")) == 0) continue;
-		if (strncmp(p, "다음 글:", strlen("다음 글:")) == 0) continue;
-		if (strncmp(p, "처음부터 보기:", strlen("처음부터 보기:")) == 0) continue;
-		
-		size_t len = strlen(p);
-		while (len > 0 && isspace((unsigned char)p[len - 1])) {
-			p[--len] = '\0';
-		}
-		
-		if (len == 0) continue;
-
-		char clean_text[MAX_PATH_LENGTH];
-		int j = 0;
-		for (int i = 0; i < len; i++) {
-			if (p[i] != '*' && p[i] != '_' && p[i] != '[' && p[i] != ']' && p[i] != '`' && p[i] != '#') {
-				clean_text[j++] = p[i];
-			}
-		}
-		clean_text[j] = '\0';
-		len = j;
-
-		if (len == 0) continue;
-
-		if (current_len > 0) {
-			if (current_len + 1 < MAX_PATH_LENGTH) {
-				strncat(excerpt_buffer, " ", sizeof(excerpt_buffer) - current_len - 1);
-				current_len++;
-			}
-		}
-
-		if (current_len + len < MAX_PATH_LENGTH) {
-			strncat(excerpt_buffer, clean_text, sizeof(excerpt_buffer) - current_len - 1);
-			current_len += len;
-		} else {
-			strncat(excerpt_buffer, clean_text, sizeof(excerpt_buffer) - current_len - 1);
-			current_len = MAX_PATH_LENGTH - 1;
-			break;
-		}
-
-		if (current_len >= EXCERPT_TARGET_LEN) {
-			break;
-		}
-	}
-	fclose(file);
-
-	if (current_len > 0) {
-		return strdup(excerpt_buffer);
-	}
-
-	return NULL;
-}
-
-SiteContext* create_site_context(const char* vault_path) {
+// cache and previous may be NULL, then every note is read and every
+// directory is listed
+SiteContext* create_site_context(const char* vault_path, const BuildCache* cache, const ScanSnapshot* previous) {
 	SiteContext* context = malloc(sizeof(SiteContext));
 	if (!context) return NULL;
 
 	context->root = create_nav_node("Home", "", true);
-	context->fast_lookup_by_name = ht_create(512);
 	context->fast_lookup_by_path = ht_create(512);
-
-	scan_recursively(context->root, context->fast_lookup_by_name, context->fast_lookup_by_path, vault_path, "");
+	context->snapshot = create_scan_snapshot();
+
+	ScanState state = {
+		.path_lookup = context->fast_lookup_by_path,
+		.base_path = vault_path,
+		.cache = cache,
+		.previous = previous,
+		.snapshot = context->snapshot,
+		.started_at = time(NULL),
+	};
+
+	char root_path[MAX_PATH_LENGTH];
+	snprintf(root_path, sizeof(root_path), "%s/", vault_path);
+	FileStamp root_stamp = { 0 };
+	struct stat root_stat;
+	if (stat(root_path, &root_stat) == 0) {
+		file_stamp_from_stat(&root_stat, &root_stamp);
+	}
+	scan_recursively(context->root, &root_stamp, &state, "");
+	context->link_resolver = create_link_resolver(context->root);
 
 	return context;
 }
@@ -155,94 +107,195 @@ SiteContext* create_site_context(const char* vault_path) {
 void free_site_context(SiteContext* context) {
 	if (!context) return;
 	free_nav_node_recursively(context->root);
-	ht_destroy(context->fast_lookup_by_name, NULL);
 	ht_destroy(context->fast_lookup_by_path, NULL);
+	free_link_resolver(context->link_resolver);
+	free_scan_snapshot(context->snapshot);
 	free(context);
 }
 
-static char* extract_slug_from_file(const char* file_path) {
-	FILE* file = fopen(file_path, "r");
-	if (!file) return NULL;
+SourceDocument* load_note_source(NavNode* node, const char* file_path) {
+	if (!node->source) {
+		node->source = load_source_document(file_path);
+	}
+	return node->source;
+}
+
+void release_note_source(NavNode* node) {
+	if (!node->source) return;
+	memcpy(node->source_digest, get_source_digest(node->source), HASH_DIGEST_SIZE);
+	node->has_source_digest = true;
+	free_source_document(node->source);
+	node->source = NULL;
+}
+
+// Takes the note's metadata from the cache when its stat stamp is unchanged,
+// otherwise reads the file.
+static void load_note_metadata(NavNode* node, const char* file_path, const struct stat* st, const BuildCache* cache) {
+	file_stamp_from_stat(st, &node->stamp);
+
+	const CacheRecord* record = cache_lookup(cache, file_path);
+	FileStamp cached_stamp;
+	if (record) {
+		cache_record_stamp(record, &cached_stamp);
+	}
 
-	char line[MAX_PATH_LENGTH];
-	if (!fgets(line, sizeof(line), file) || strncmp(line, "---", 3) != 0) {
-		fclose(file);
-		return NULL;
+	if (record && file_stamp_equal(&cached_stamp, &node->stamp)) {
+		cache_record_metadata(cache, record, &node->meta);
+	} else if (load_note_source(node, file_path)) {
+		copy_note_metadata(&node->meta, &node->source->meta);
+		node->stamp = node->source->stamp;
 	}
 
-	char* slug = NULL;
-	while (fgets(line, sizeof(line), file)) {
-		if (strncmp(line, "---", 3) == 0) break;
+	if (node->meta.slug) {
+		node->slug = strdup(node->meta.slug);
+	} else {
+		char* name_copy = strdup(node->name);
+		char* dot = strrchr(name_copy, '.');
+		if (dot) *dot = '\0';
+		node->slug = name_copy;
+	}
+}
 
-		if (strncmp(line, "slug:", 5) == 0) {
-			char* value = line + 5;
-			while (*value && isspace((unsigned char)*value)) {
-				value++;
-			}
+// Digest of everything the scan knows about a directory: child names, note
+// metadata and the digests of subdirectories. Equal digests mean the subtree
+// has the same notes with the same metadata.
+static void append_digest_field(DynamicBuffer* buffer, const char* value) {
+	if (value) buffer_append_bytes(buffer, value, strlen(value));
+	buffer_append_bytes(buffer, "", 1);
+}
 
-			size_t len = strlen(value);
-			while (len > 0 && isspace((unsigned char)value[len - 1])) {
-				value[--len] = '\0';
-			}
-			slug = strdup(value);
-			break;
+static void compute_tree_digest(NavNode* dir) {
+	DynamicBuffer* buffer = create_dynamic_buffer(1024);
+	NavNode* child;
+	list_for_each_entry(child, &dir->children, sibling) {
+		append_digest_field(buffer, child->is_directory ? "d" : "f");
+		append_digest_field(buffer, child->name);
+
+		if (child->is_directory) {
+			buffer_append_bytes(buffer, child->tree_digest, HASH_DIGEST_SIZE);
+		} else if (strstr(child->name, ".md")) {
+			const NoteMetadata* meta = &child->meta;
+			append_digest_field(buffer, child->slug);
+			append_digest_field(buffer, meta->excerpt);
+			append_digest_field(buffer, meta->title);
+			append_digest_field(buffer, meta->date);
+			buffer_append_formatted(buffer, "%d:%d:%d", meta->id, meta->order, meta->has_order);
+			buffer_append_bytes(buffer, "", 1);
 		}
 	}
-	fclose(file);
-	return slug;
+	generate_buffer_digest(buffer->content, buffer->length, dir->tree_digest);
+	free(destroy_buffer_and_get_content(buffer));
 }
 
-static void scan_recursively(NavNode* parent, HashTable* name_lookup, HashTable* path_lookup, const char* base_path, const char* current_subpath) {
-	char current_full_path[MAX_PATH_LENGTH];
-	snprintf(current_full_path, sizeof(current_full_path), "%s/%s", base_path, current_subpath);
+static void scan_entry(NavNode* parent, const char* name, const SnapshotEntry* known, ScanState* state, const char* current_full_path, const char* current_subpath, DirectorySnapshot* listing_out) {
+	// the note path, base_path/relative, is the longest of the three
+	char entry_relative_path[MAX_PATH_LENGTH];
+	char entry_full_path[MAX_PATH_LENGTH];
+	char note_path[MAX_PATH_LENGTH];
+	int relative_len = snprintf(entry_relative_path, sizeof(entry_relative_path), "%s%s%s", current_subpath, (strlen(current_subpath) > 0 ? "/" : ""), name);
+	int full_len = snprintf(entry_full_path, sizeof(entry_full_path), "%s/%s", current_full_path, name);
+	int note_len = snprintf(note_path, sizeof(note_path), "%s/%s", state->base_path, entry_relative_path);
+	if (relative_len < 0 || full_len < 0 || note_len < 0
+			|| (size_t)relative_len >= sizeof(entry_relative_path)
+			|| (size_t)full_len >= sizeof(entry_full_path)
+			|| (size_t)note_len >= sizeof(note_path)) {
+		fprintf(stderr, "[ERROR] Path is too long, skipped: %s/%s\n", current_full_path, name);
+		return;
+	}
 
-	DIR* dir = opendir(current_full_path);
-	if (!dir) return;
+	// a file from an unchanged listing that is not a note needs nothing but its name
+	bool is_note = strstr(name, ".md") != NULL;
+	struct stat entry_stat;
+	bool is_dir;
+	if (known && !known->is_directory && !is_note) {
+		is_dir = false;
+	} else {
+		if (stat(entry_full_path, &entry_stat) != 0) return;
+		is_dir = S_ISDIR(entry_stat.st_mode);
+	}
 
-	struct dirent* entry;
-	while ((entry = readdir(dir)) != NULL) {
-		if (entry->d_name[0] == '.') continue;
+	NavNode* new_node = create_nav_node(name, entry_relative_path, is_dir);
 
-		char entry_relative_path[MAX_PATH_LENGTH];
-		snprintf(entry_relative_path, sizeof(entry_relative_path), "%s%s%s", current_subpath, (strlen(current_subpath) > 0 ? "/" : ""), entry->d_name);
+	if (!is_dir && is_note) {
+		// same form as the build cache keys
+		load_note_metadata(new_node, note_path, &entry_stat, state->cache);
+	}
 
-		char entry_full_path[MAX_PATH_LENGTH];
-		int required_len = snprintf(entry_full_path, sizeof(entry_full_path), "%s/%s", current_full_path, entry->d_name);
+	list_add_tail(&new_node->sibling, &parent->children);
 
-		if (required_len >= sizeof(entry_full_path)) {
-			fprintf(stderr, "Warning: Path is too long and was truncated: %s\n", current_full_path);
-			continue;
-		}
+	ht_set(state->path_lookup, new_node->full_path, new_node);
+	if (listing_out) {
+		directory_snapshot_add_entry(listing_out, name, is_dir);
+	}
 
-		struct stat entry_stat;
-		if (stat(entry_full_path, &entry_stat) != 0) continue;
+	if (is_dir) {
+		FileStamp dir_stamp;
+		file_stamp_from_stat(&entry_stat, &dir_stamp);
+		scan_recursively(new_node, &dir_stamp, state, entry_relative_path);
+	}
+}
 
-		bool is_dir = S_ISDIR(entry_stat.st_mode);
-		NavNode* new_node = create_nav_node(entry->d_name, entry_relative_path, is_dir);
+// A directory whose stamp matches the previous snapshot is not listed again;
+// its entries are replayed from the snapshot in the original readdir order.
+static void scan_recursively(NavNode* parent, const FileStamp* dir_stamp, ScanState* state, const char* current_subpath) {
+	char current_full_path[MAX_PATH_LENGTH];
+	snprintf(current_full_path, sizeof(current_full_path), "%s/%s", state->base_path, current_subpath);
 
-		if (!is_dir && strstr(new_node->name, ".md")) {
-			new_node->slug = extract_slug_from_file(entry_full_path);
+	// a directory changed during this second could change again without
+	// moving its mtime, so it is listed again next time
+	DirectorySnapshot* listing_out = NULL;
+	if (dir_stamp->inode != 0 && dir_stamp->mtime_sec < state->started_at && dir_stamp->ctime_sec < state->started_at) {
+		listing_out = add_directory_snapshot(state->snapshot, current_full_path, dir_stamp);
+	}
 
-			new_node->excerpt = extract_excerpt_from_file(entry_full_path);
+	const DirectorySnapshot* listing = find_directory_snapshot(state->previous, current_full_path, dir_stamp);
+	if (listing) {
+		for (size_t i = 0; i < listing->count; i++) {
+			scan_entry(parent, listing->entries[i].name, &listing->entries[i], state, current_full_path, current_subpath, listing_out);
+		}
+	} else {
+		DIR* dir = opendir(current_full_path);
+		if (!dir) return;
 
-			if (!new_node->slug) {
-				char* name_copy = strdup(new_node->name);
-				char* dot = strrchr(name_copy, '.');
-				if (dot) *dot = '\0';
-				new_node->slug = name_copy;
-			}
+		struct dirent* entry;
+		while ((entry = readdir(dir)) != NULL) {
+			if (entry->d_name[0] == '.') continue;
+			scan_entry(parent, entry->d_name, NULL, state, current_full_path, current_subpath, listing_out);
 		}
+		closedir(dir);
+	}
 
-		list_add_tail(&new_node->sibling, &parent->children);
+	compute_tree_digest(parent);
+}
 
-		ht_set(name_lookup, new_node->name, new_node);
-		ht_set(path_lookup, new_node->full_path, new_node);
+NavNode* find_link_target(SiteContext* context, const char* link_target) {
+	const LinkTarget* target = resolve_link_target(context->link_resolver, link_target);
+	return target ? target->node : NULL;
+}
 
-		if (is_dir) {
-			scan_recursively(new_node, name_lookup, path_lookup, base_path, entry_relative_path);
-		}
+// URL of a [[wikilink]] target relative to base_url, or NULL if it does not
+// exist. Owned by the resolver, shared by every link to the same target. A
+// heading or block the note does not have links to the note itself.
+static const char* resolve_link(SiteContext* context, const char* link_target, const unsigned char** url_digest) {
+	const LinkTarget* target = resolve_link_target(context->link_resolver, link_target);
+	if (!target) return NULL;
+	const LinkAnchor* anchor = resolve_link_anchor(context->link_resolver, target, find_link_fragment(link_target));
+	*url_digest = anchor ? anchor->url_digest : target->url_digest;
+	return anchor ? anchor->url : target->url;
+}
+
+const char* resolve_link_url(SiteContext* context, const char* link_target) {
+	const unsigned char* url_digest;
+	return resolve_link(context, link_target, &url_digest);
+}
+
+void resolve_link_digest(SiteContext* context, const char* link_target, unsigned char* digest) {
+	const unsigned char* url_digest = NULL;
+	if (resolve_link(context, link_target, &url_digest)) {
+		memcpy(digest, url_digest, HASH_DIGEST_SIZE);
+	} else {
+		memset(digest, 0, HASH_DIGEST_SIZE);
 	}
-	closedir(dir);
 }
 
 void generate_sidebar_html(SiteContext* s_context, TemplateContext* global_context) {
@@ -267,7 +320,8 @@ void generate_breadcrumb_html(NavNode* current_node, TemplateContext* local_cont
 	buffer_append_formatted(buffer, "<a href=\"%s/\">Home</a>", base_url);
 
 	char* path_copy = strdup(current_node->full_path);
-	char* token = strtok(path_copy, "/");
+	char* saveptr = NULL;
+	char* token = strtok_r(path_copy, "/", &saveptr);
 	DynamicBuffer* current_path_buffer = create_dynamic_buffer(256);
 
 	while (token != NULL) {
@@ -278,7 +332,7 @@ void generate_breadcrumb_html(NavNode* current_node, TemplateContext* local_cont
 
 		NavNode* node = ht_get(s_context->fast_lookup_by_path, current_path_buffer->content);
 		if (!node) {
-			token = strtok(NULL, "/");
+			token = strtok_r(NULL, "/", &saveptr);
 			continue;
 		}
 
@@ -299,7 +353,7 @@ void generate_breadcrumb_html(NavNode* current_node, TemplateContext* local_cont
 			free(display_name);
 		}
 
-		token = strtok(NULL, "/");
+		token = strtok_r(NULL, "/", &saveptr);
 	}
 	free(path_copy);
 	destroy_buffer_and_get_content(current_path_buffer);
@@ -0,0 +1,321 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <sys/stat.h>
+
+#include "../include/source_document.h"
+#include "../include/hash_utils.h"
+
+#define MAX_PATH_LENGTH 1024
+#define EXCERPT_TARGET_LEN 150
+
+// fgets() over a memory buffer, so lines split exactly like the old FILE readers did
+static bool read_line(const char** cursor, const char* end, char* line, size_t size) {
+	if (*cursor >= end) return false;
+
+	size_t n = 0;
+	while (*cursor < end && n < size - 1) {
+		char c = *(*cursor)++;
+		line[n++] = c;
+		if (c == '\n') break;
+	}
+	line[n] = '\0';
+	return true;
+}
+
+static char* trim_whitespace(char* str) {
+	while (isspace((unsigned char)*str)) str++;
+	if (*str == 0) return str;
+
+	char *end = str + strlen(str) - 1;
+	while (end > str && isspace((unsigned char)*end)) end--;
+	end[1] = '\0';
+	return str;
+}
+
+static void parse_front_matter_line(SourceDocument* doc, char* line) {
+	if (!doc->meta.slug && strncmp(line, "slug:", 5) == 0) {
+		char* value = line + 5;
+		while (*value && isspace((unsigned char)*value)) {
+			value++;
+		}
+
+		size_t len = strlen(value);
+		while (len > 0 && isspace((unsigned char)value[len - 1])) {
+			len--;
+		}
+		doc->meta.slug = strndup(value, len);
+	}
+
+	char* saveptr = NULL;
+	char* key = strtok_r(line, ":", &saveptr);
+	char* value = strtok_r(NULL, "\n", &saveptr);
+	if (!key || !value) return;
+
+	char* trimmed_key = trim_whitespace(key);
+	char* trimmed_value = trim_whitespace(value);
+	add_to_context(doc->front_matter, trimmed_key, trimmed_value);
+
+	if (strcmp(trimmed_key, "id") == 0) doc->meta.id = atoi(trimmed_value);
+	if (strcmp(trimmed_key, "order") == 0) {
+		doc->meta.order = atoi(trimmed_value);
+		doc->meta.has_order = true;
+	}
+	if (strcmp(trimmed_key, "date") == 0) {
+		free(doc->meta.date);
+		doc->meta.date = strdup(trimmed_value);
+	}
+	if (strcmp(trimmed_key, "title") == 0) {
+		free(doc->meta.title);
+		doc->meta.title = strdup(trimmed_value);
+	}
+}
+
+// Appends one alias, without surrounding whitespace and quotes, to the
+// newline-separated list.
+static void add_alias(NoteMetadata* meta, const char* alias, size_t length) {
+	while (length > 0 && isspace((unsigned char)alias[0])) {
+		alias++;
+		length--;
+	}
+	while (length > 0 && isspace((unsigned char)alias[length - 1])) {
+		length--;
+	}
+	if (length >= 2 && (alias[0] == '"' || alias[0] == '\'') && alias[length - 1] == alias[0]) {
+		alias++;
+		length -= 2;
+	}
+	if (length == 0) return;
+
+	size_t old_length = meta->aliases ? strlen(meta->aliases) : 0;
+	char* aliases = realloc(meta->aliases, old_length + length + 2);
+	if (old_length > 0) aliases[old_length++] = '\n';
+	memcpy(aliases + old_length, alias, length);
+	aliases[old_length + length] = '\0';
+	meta->aliases = aliases;
+}
+
+// "aliases: name", "aliases: [a, b]" or a bare "aliases:" that a block list
+// follows. Returns true in the last case.
+static bool parse_aliases_line(SourceDocument* doc, const char* line) {
+	const char* value;
+	if (strncmp(line, "aliases:", 8) == 0) value = line + 8;
+	else if (strncmp(line, "alias:", 6) == 0) value = line + 6;
+	else return false;
+
+	while (isspace((unsigned char)*value)) value++;
+	size_t length = strlen(value);
+	while (length > 0 && isspace((unsigned char)value[length - 1])) length--;
+	if (length == 0) return true;
+
+	if (value[0] == '[' && value[length - 1] == ']') {
+		const char* item = value + 1;
+		const char* end = value + length - 1;
+		while (item <= end) {
+			const char* comma = memchr(item, ',', end - item);
+			const char* item_end = comma ? comma : end;
+			add_alias(&doc->meta, item, item_end - item);
+			item = item_end + 1;
+		}
+	} else {
+		add_alias(&doc->meta, value, length);
+	}
+	return false;
+}
+
+// "  - name" inside an aliases block list
+static bool parse_alias_item(SourceDocument* doc, const char* line) {
+	while (*line == ' ' || *line == '\t') line++;
+	if (*line != '-' || !isspace((unsigned char)line[1])) return false;
+	add_alias(&doc->meta, line + 1, strlen(line + 1));
+	return true;
+}
+
+static void parse_front_matter(SourceDocument* doc) {
+	const char* end = doc->content + doc->length;
+	const char* cursor = doc->content;
+	char line[MAX_PATH_LENGTH];
+
+	doc->body = doc->content;
+	if (!read_line(&cursor, end, line, sizeof(line)) || strncmp(line, "---", 3) != 0) {
+		return;
+	}
+
+	bool in_alias_list = false;
+	while (read_line(&cursor, end, line, sizeof(line)) && strncmp(line, "---", 3) != 0) {
+		if (in_alias_list && parse_alias_item(doc, line)) continue;
+		in_alias_list = parse_aliases_line(doc, line);
+		parse_front_matter_line(doc, line);
+	}
+	doc->body = cursor;
+}
+
+static bool is_block_id(const char* id) {
+	if (!*id) return false;
+	for (const char* c = id; *c; c++) {
+		if (!isalnum((unsigned char)*c) && *c != '-') return false;
+	}
+	return true;
+}
+
+static char* extract_excerpt(const char* body, const char* end) {
+	const char* cursor = body;
+	char line[MAX_PATH_LENGTH];
+
+	char excerpt_buffer[MAX_PATH_LENGTH] = {0};
+	int current_len = 0;
+
+	while (read_line(&cursor, end, line, sizeof(line))) {
+		char* p = line;
+
+		// ignore markdown grammer, whitespaces
+		while (*p && (isspace((unsigned char)*p) || *p == '-' || *p == '*' || *p == '>')) {
+			p++;
+		}
+
+		if (*p == '\0') continue;
+
+		if (p[0] == '#') continue;
+		if (strncmp(p, "이전 글:", strlen("이전 글:")) == 0) continue;
+		if (strncmp(p, "다음 글:", strlen("다음 글:")) == 0) continue;
+		if (strncmp(p, "처음부터 보기:", strlen("처음부터 보기:")) == 0) continue;
+
+		size_t len = strlen(p);
+		while (len > 0 && isspace((unsigned char)p[len - 1])) {
+			p[--len] = '\0';
+		}
+
+		// an Obsidian block id, " ^id" or a line of its own, is not part of the text
+		char* caret = strrchr(p, '^');
+		if (caret && (caret == p || isspace((unsigned char)caret[-1])) && is_block_id(caret + 1)) {
+			len = caret - p;
+			while (len > 0 && isspace((unsigned char)p[len - 1])) {
+				p[--len] = '\0';
+			}
+		}
+
+		if (len == 0) continue;
+
+		char clean_text[MAX_PATH_LENGTH];
+		int j = 0;
+		for (int i = 0; i < len; i++) {
+			if (p[i] != '*' && p[i] != '_' && p[i] != '[' && p[i] != ']' && p[i] != '`' && p[i] != '#') {
+				clean_text[j++] = p[i];
+			}
+		}
+		clean_text[j] = '\0';
+		len = j;
+
+		if (len == 0) continue;
+
+		if (current_len > 0) {
+			if (current_len + 1 < MAX_PATH_LENGTH) {
+				strncat(excerpt_buffer, " ", sizeof(excerpt_buffer) - current_len - 1);
+				current_len++;
+			}
+		}
+
+		if (current_len + len < MAX_PATH_LENGTH) {
+			strncat(excerpt_buffer, clean_text, sizeof(excerpt_buffer) - current_len - 1);
+			current_len += len;
+		} else {
+			strncat(excerpt_buffer, clean_text, sizeof(excerpt_buffer) - current_len - 1);
+			current_len = MAX_PATH_LENGTH - 1;
+			break;
+		}
+
+		if (current_len >= EXCERPT_TARGET_LEN) {
+			break;
+		}
+	}
+
+	if (current_len > 0) {
+		return strdup(excerpt_buffer);
+	}
+
+	return NULL;
+}
+
+SourceDocument* load_source_document(const char* file_path) {
+	FILE* file = fopen(file_path, "rb");
+	if (!file) return NULL;
+
+	struct stat st;
+	if (fstat(fileno(file), &st) != 0) {
+		fclose(file);
+		return NULL;
+	}
+	long length = st.st_size;
+
+	SourceDocument* doc = calloc(1, sizeof(SourceDocument));
+	file_stamp_from_stat(&st, &doc->stamp);
+	if (length > SOURCE_STREAM_THRESHOLD) {
+		doc->path = strdup(file_path);
+		length = SOURCE_STREAM_CHUNK;
+	}
+	doc->content = malloc(length + 1);
+	if (!doc->content) {
+		perror("Failed to allocate buffer for source document");
+		fclose(file);
+		free(doc);
+		return NULL;
+	}
+	doc->length = fread(doc->content, 1, length, file);
+	doc->content[doc->length] = '\0';
+	fclose(file);
+
+	doc->front_matter = create_template_context();
+	doc->meta.date = strdup("9999-99-99");
+
+	parse_front_matter(doc);
+	doc->body_offset = doc->body - doc->content;
+	doc->meta.excerpt = extract_excerpt(doc->body, doc->content + doc->length);
+
+	return doc;
+}
+
+const unsigned char* get_source_digest(SourceDocument* doc) {
+	if (!doc->has_digest) {
+		if (doc->path) {
+			doc->has_digest = generate_file_digest(doc->path, doc->digest);
+		} else {
+			generate_buffer_digest(doc->content, doc->length, doc->digest);
+			doc->has_digest = true;
+		}
+	}
+	return doc->digest;
+}
+
+void free_source_document(SourceDocument* doc) {
+	if (!doc) return;
+	free(doc->content);
+	free(doc->path);
+	free_template_context(doc->front_matter);
+	free_note_metadata(&doc->meta);
+	free(doc);
+}
+
+static char* strdup_or_null(const char* str) {
+	return str ? strdup(str) : NULL;
+}
+
+void copy_note_metadata(NoteMetadata* dest, const NoteMetadata* src) {
+	dest->slug = strdup_or_null(src->slug);
+	dest->excerpt = strdup_or_null(src->excerpt);
+	dest->title = strdup_or_null(src->title);
+	dest->date = strdup_or_null(src->date);
+	dest->aliases = strdup_or_null(src->aliases);
+	dest->id = src->id;
+	dest->order = src->order;
+	dest->has_order = src->has_order;
+}
+
+void free_note_metadata(NoteMetadata* meta) {
+	free(meta->slug);
+	free(meta->excerpt);
+	free(meta->title);
+	free(meta->date);
+	free(meta->aliases);
+	memset(meta, 0, sizeof(NoteMetadata));
+}
@@ -7,9 +7,12 @@ BUILD_DIR="builds"
 TEMP_DIR=$(mktemp -d)
 
 TOKENIZER_TEST="$BUILD_DIR/test_tokenizer"
+CHUNKED_TOKENIZER_TEST="$BUILD_DIR/test_chunked_tokenizer"
 PARSER_TEST="$BUILD_DIR/test_parser"
+AST_CACHE_TEST="$BUILD_DIR/test_ast_cache"
 HTML_GENERATOR_TEST="$BUILD_DIR/test_html_generator"
 TEMPLATE_ENGINE_TEST="$BUILD_DIR/test_template_engine"
+EXCERPT_TEST="$BUILD_DIR/test_excerpt"
 
 total_tests=0
 passed_tests=0
@@ -49,9 +52,12 @@ run_test_suite() {
 }
 
 run_test_suite "Tokenizer"       "$TOKENIZER_TEST"       "tokens.expected"     "tokens.actual"
+run_test_suite "Chunked Tokenizer" "$CHUNKED_TOKENIZER_TEST" "tokens.expected"   "chunked.actual"
 run_test_suite "Parser"          "$PARSER_TEST"          "ast.expected"        "ast.actual"
+run_test_suite "AST Cache"       "$AST_CACHE_TEST"       "ast.expected"        "cached.actual"
 run_test_suite "HTML Generator"  "$HTML_GENERATOR_TEST"  "html.expected"       "html.actual"
 run_test_suite "Template Engine" "$TEMPLATE_ENGINE_TEST" "final.html" "final.actual"
+run_test_suite "Excerpt"         "$EXCERPT_TEST"         "excerpt.expected"    "excerpt.actual"
 
 
 echo "========================================="
@@ -0,0 +1,75 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../../src/include/tokenizer.h"
+#include "../../src/include/parser.h"
+#include "../../src/include/dynamic_buffer.h"
+
+// Parse time for adversarial inline inputs: long runs of openers that never
+// close. Every case should scale linearly with its repeat count.
+// Usage: bench_inline_parser [repeat_count]  (default: 100000)
+
+typedef struct {
+	const char* label;
+	const char* unit;
+} AdversarialCase;
+
+static const AdversarialCase cases[] = {
+	{ "asterisk run", "*" },
+	{ "dollar run", "$" },
+	{ "bracket run", "[" },
+	{ "unclosed link text", "[a " },
+	{ "unclosed link url", "[a](b " },
+	{ "unclosed wikilinks", "[[a " },
+	{ "unclosed image embeds", "![[a " },
+	{ "unclosed display math", "$$a $" },
+	{ "unmatched emphasis", "***a ** " },
+};
+
+static double now_seconds() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static char* repeat_unit(const char* unit, size_t count) {
+	size_t unit_length = strlen(unit);
+	DynamicBuffer* buffer = create_dynamic_buffer(unit_length * count + 2);
+	for (size_t i = 0; i < count; i++) {
+		buffer_append_bytes(buffer, unit, unit_length);
+	}
+	buffer_append_bytes(buffer, "\n", 1);
+	return destroy_buffer_and_get_content(buffer);
+}
+
+static double parse_seconds(const char* content) {
+	double start = now_seconds();
+	TokenStream* tokens = create_token_stream(content);
+	Ast* ast = parse_tokens(tokens, NULL);
+	free_token_stream(tokens);
+	free_ast(ast);
+	return now_seconds() - start;
+}
+
+int main(int argc, char* argv[]) {
+	size_t count = argc > 1 ? strtoul(argv[1], NULL, 10) : 100000;
+
+	for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+		char* full = repeat_unit(cases[i].unit, count);
+		char* half = repeat_unit(cases[i].unit, count / 2);
+		double full_seconds = parse_seconds(full);
+		double half_seconds = parse_seconds(half);
+
+		// Doubling the input should roughly double the time; quadratic
+		// parsing shows up as a ratio near four.
+		printf("%-24s x%-8zu %9.2f ms  (x%zu: %8.2f ms, ratio %.1f)\n",
+				cases[i].label, count, full_seconds * 1000,
+				count / 2, half_seconds * 1000,
+				half_seconds > 0 ? full_seconds / half_seconds : 0.0);
+		free(full);
+		free(half);
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,65 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../src/include/tokenizer.h"
+#include "../../src/include/parser.h"
+#include "../../src/include/dynamic_buffer.h"
+
+// Peak token window while parsing a long note that opens an inline element
+// early and never closes it. The closer search stops at the end of the block,
+// so the window should stay the same however long the note gets.
+// Usage: bench_token_window [paragraph_count]  (default: 100000)
+
+typedef struct {
+	const char* label;
+	const char* opener;
+} UnclosedCase;
+
+static const UnclosedCase cases[] = {
+	{ "no opener", "" },
+	{ "unmatched $", "$" },
+	{ "unmatched $$", "$$" },
+	{ "unclosed link url", "[a](b " },
+	{ "unclosed wikilink", "[[a " },
+	{ "unclosed image embed", "![[a " },
+	{ "$ in a list item", "- $" },
+};
+
+static char* build_note(const char* opener, size_t paragraphs) {
+	static const char* paragraph = "A paragraph of plain words with **bold** and `code` in it\nand a second line.\n\n";
+	size_t opener_length = strlen(opener);
+	size_t paragraph_length = strlen(paragraph);
+
+	DynamicBuffer* buffer = create_dynamic_buffer(opener_length + paragraph_length * paragraphs + 1);
+	buffer_append_bytes(buffer, opener, opener_length);
+	for (size_t i = 0; i < paragraphs; i++) {
+		buffer_append_bytes(buffer, paragraph, paragraph_length);
+	}
+	return destroy_buffer_and_get_content(buffer);
+}
+
+static size_t peak_window(const char* content) {
+	TokenStream* tokens = create_token_stream(content);
+	Ast* ast = parse_tokens(tokens, NULL);
+	size_t peak = token_stream_peak_window(tokens);
+	free_token_stream(tokens);
+	free_ast(ast);
+	return peak;
+}
+
+int main(int argc, char* argv[]) {
+	size_t count = argc > 1 ? strtoul(argv[1], NULL, 10) : 100000;
+
+	for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+		char* full = build_note(cases[i].opener, count);
+		char* half = build_note(cases[i].opener, count / 2);
+
+		// a bounded window is the same size for both notes
+		printf("%-22s x%-8zu %9zu tokens  (x%zu: %9zu tokens)\n",
+				cases[i].label, count, peak_window(full), count / 2, peak_window(half));
+		free(full);
+		free(half);
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../../src/include/tokenizer.h"
+#include "../../src/include/parser.h"
+#include "../../src/include/ast_cache.h"
+#include "../../src/include/cache_manager.h"
+#include "../../src/include/hash_utils.h"
+#include "../../src/include/dynamic_buffer.h"
+
+// Stores the parsed file in a scratch AST cache, loads it back, resolves its
+// wikilinks and prints it in the test_parser format.
+
+static const char* ast_node_type_to_string(AstNodeType type) {
+	switch (type) {
+		case NODE_DOCUMENT: return "DOCUMENT";
+		case NODE_HEADING1: return "HEADING1";
+		case NODE_HEADING2: return "HEADING2";
+		case NODE_HEADING3: return "HEADING3";
+		case NODE_PARAGRAPH: return "PARAGRAPH";
+		case NODE_CODE_BLOCK: return "CODE_BLOCK";
+		case NODE_LINE: return "LINE";
+		case NODE_ORDERED_LIST: return "ORDERED_LIST";
+		case NODE_UNORDERED_LIST: return "UNORDERED_LIST";
+		case NODE_LIST_ITEM: return "LIST_ITEM";
+		case NODE_IMAGE_LINK: return "IMAGE_LINK";
+		case NODE_TEXT: return "TEXT";
+		case NODE_ITALIC: return "ITALIC";
+		case NODE_BOLD: return "BOLD";
+		case NODE_ITALIC_AND_BOLD: return "ITALIC_AND_BOLD";
+		case NODE_CODE: return "CODE";
+		case NODE_LINK: return "LINK";
+		case NODE_SOFT_BREAK: return "SOFT_BREAK";
+		default: return "UNKNOWN";
+	}
+}
+
+static void print_ast_stdout(const Ast* ast, AstNodeId id, int indent) {
+	const AstNode* node = ast_node(ast, id);
+	if (!node) return;
+	for (int i = 0; i < indent; ++i) fprintf(stdout, "\t");
+
+	fprintf(stdout, "-> %s", ast_node_type_to_string(node->type));
+	if (ast_data1(ast, node)) fprintf(stdout, " | data1: \"%s\"", ast_data1(ast, node));
+	if (ast_data2(ast, node)) fprintf(stdout, " | data2: \"%s\"", ast_data2(ast, node));
+	fprintf(stdout, "\n");
+
+	for (AstNodeId child = node->first_child; child != AST_NONE; child = ast->nodes[child].next_sibling) {
+		print_ast_stdout(ast, child, indent + 1);
+	}
+}
+
+int main(int argc, char *argv[]) {
+	if (argc < 2) {
+		fprintf(stderr, "Usage: %s <input_markdown_file>\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	// the site index is built from the repository, before moving into the scratch directory
+	SiteContext* s_context = create_site_context(".", NULL, NULL);
+
+	FILE* test_file = fopen(argv[1], "r");
+	if (!test_file) {
+		perror("Failed to open file");
+		return EXIT_FAILURE;
+	}
+
+	DynamicBuffer* db = create_dynamic_buffer(0);
+	char line[1024];
+	while(fgets(line, sizeof(line), test_file)) {
+		buffer_append_formatted(db, "%s", line);
+	}
+	fclose(test_file);
+	char* content_md = destroy_buffer_and_get_content(db);
+
+	char original_dir[4096];
+	char scratch_dir[] = "/tmp/ssg_ast_cache_XXXXXX";
+	if (!getcwd(original_dir, sizeof(original_dir)) || !mkdtemp(scratch_dir) || chdir(scratch_dir) != 0) {
+		perror("Failed to enter scratch directory");
+		return EXIT_FAILURE;
+	}
+
+	unsigned char digest[HASH_DIGEST_SIZE];
+	generate_buffer_digest(content_md, strlen(content_md), digest);
+
+	TokenStream* tokens = create_token_stream(content_md);
+	Ast* parsed = parse_document(tokens);
+	free_token_stream(tokens);
+	store_cached_ast(digest, parsed);
+	free_ast(parsed);
+
+	Ast* ast = load_cached_ast(digest);
+	if (!ast) {
+		fprintf(stderr, "Failed to load the cached Ast\n");
+		return EXIT_FAILURE;
+	}
+	resolve_wikilinks(ast, s_context);
+
+	print_ast_stdout(ast, 0, 0);
+
+	// leave no cache files behind
+	char cache_file[512];
+	char hex[HASH_HEX_LENGTH + 1];
+	digest_to_hex_string(digest, hex);
+	snprintf(cache_file, sizeof(cache_file), "%s/%s/%s%s", CACHE_DIR, AST_CACHE_DIR, hex, AST_CACHE_SUFFIX);
+	remove(cache_file);
+	rmdir(CACHE_DIR "/" AST_CACHE_DIR);
+	rmdir(CACHE_DIR);
+	if (chdir(original_dir) == 0) rmdir(scratch_dir);
+
+	free_ast(ast);
+	free(content_md);
+	free_site_context(s_context);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,125 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../src/include/tokenizer.h"
+#include "../../src/include/parser.h"
+#include "../../src/include/dynamic_buffer.h"
+
+// Tokenizes the file whole and in chunks of 1 B to 1 MB, checks that every
+// run yields the same tokens (type, offset, length, text) and that parsing a
+// file stream yields the same Ast as parsing the whole text, and prints the
+// tokens in the test_tokenizer format.
+
+static const size_t chunk_sizes[] = { 1, 2, 3, 4, 5, 7, 16, 31, 64, 100, 1000, 4096, 65536, 1024 * 1024 };
+
+static const char* token_type_to_string(TokenType type) {
+	switch (type) {
+		case TOKEN_HASH: return "HASH";
+		case TOKEN_ASTERISK: return "ASTERISK";
+		case TOKEN_TEXT: return "TEXT";
+		case TOKEN_NUMBER: return "NUMBER";
+		case TOKEN_DOT: return "DOT";
+		case TOKEN_DASH: return "DASH";
+		case TOKEN_NEWLINE: return "NEWLINE";
+		case TOKEN_TAB: return "TAB";
+		case TOKEN_LBRACKET: return "LBRACKET";
+		case TOKEN_RBRACKET: return "RBRACKET";
+		case TOKEN_LPAREN: return "LPAREN";
+		case TOKEN_RPAREN: return "RPAREN";
+		case TOKEN_BACKTICK: return "BACKTICK";
+		case TOKEN_EXCLAMATION: return "EXCLAMATION";
+		case TOKEN_GREATER_THAN: return "GREATER_THAN";
+		case TOKEN_BACKSLASH: return "BACKSLASH";
+		case TOKEN_EOF: return "EOF";
+		default: return "UNKNOWN";
+	}
+}
+
+static void describe_token(const Token* token, const char* text, void* context) {
+	DynamicBuffer* buffer = (DynamicBuffer*)context;
+	buffer_append_formatted(buffer, "%d %zu %zu ", token->type, token->offset, token->length);
+	buffer_append_bytes(buffer, text, token->length);
+	buffer_append_bytes(buffer, "\n", 1);
+}
+
+static bool same_ast(const Ast* a, const Ast* b) {
+	if (a->node_count != b->node_count || a->link_count != b->link_count || a->strings_length != b->strings_length) {
+		return false;
+	}
+	for (size_t i = 0; i < a->node_count; i++) {
+		const AstNode* x = &a->nodes[i];
+		const AstNode* y = &b->nodes[i];
+		if (x->type != y->type || x->first_child != y->first_child || x->next_sibling != y->next_sibling ||
+				x->data1 != y->data1 || x->data2 != y->data2) {
+			return false;
+		}
+	}
+	return memcmp(a->links, b->links, a->link_count * sizeof(AstNodeId)) == 0 &&
+		memcmp(a->strings, b->strings, a->strings_length) == 0;
+}
+
+int main(int argc, char* argv[]) {
+	if (argc < 2) {
+		fprintf(stderr, "Usage: %s <input_markdown_file>\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	FILE* file = fopen(argv[1], "rb");
+	if (!file) {
+		perror("Failed to read file");
+		return EXIT_FAILURE;
+	}
+
+	TokenList tokens;
+	char* source = tokenize_file(file, &tokens);
+	DynamicBuffer* expected = create_dynamic_buffer(4096);
+	for (size_t i = 0; i < tokens.count; i++) {
+		describe_token(&tokens.items[i], token_text(source, &tokens.items[i]), expected);
+	}
+
+	int failures = 0;
+	for (size_t i = 0; i < sizeof(chunk_sizes) / sizeof(chunk_sizes[0]); i++) {
+		DynamicBuffer* actual = create_dynamic_buffer(4096);
+		rewind(file);
+		tokenize_file_chunked(file, chunk_sizes[i], describe_token, actual);
+		if (actual->length != expected->length || memcmp(actual->content, expected->content, expected->length) != 0) {
+			fprintf(stderr, "Tokens differ with %zu byte chunks\n", chunk_sizes[i]);
+			failures++;
+		}
+		free(destroy_buffer_and_get_content(actual));
+	}
+
+	TokenStream* whole_stream = create_token_stream(source);
+	Ast* whole = parse_document(whole_stream);
+	free_token_stream(whole_stream);
+	for (size_t i = 0; i < sizeof(chunk_sizes) / sizeof(chunk_sizes[0]); i++) {
+		rewind(file);
+		TokenStream* stream = create_file_token_stream(file, chunk_sizes[i]);
+		Ast* ast = parse_document(stream);
+		free_token_stream(stream);
+		if (!same_ast(whole, ast)) {
+			fprintf(stderr, "Ast differs with %zu byte chunks\n", chunk_sizes[i]);
+			failures++;
+		}
+		free_ast(ast);
+	}
+	free_ast(whole);
+	fclose(file);
+
+	if (failures == 0) {
+		for (size_t i = 0; i < tokens.count; i++) {
+			const Token* token = &tokens.items[i];
+			fprintf(stdout, "[%s]", token_type_to_string(token->type));
+			if (token->type == TOKEN_TEXT || token->type == TOKEN_NUMBER) {
+				fprintf(stdout, "{\"%.*s\"}", (int)token->length, token_text(source, token));
+			}
+			fprintf(stdout, "\n");
+		}
+	}
+
+	free(destroy_buffer_and_get_content(expected));
+	free_tokens(&tokens);
+	free(source);
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,24 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../../src/include/source_document.h"
+
+// Prints the excerpt a note gets for its feed entry and description.
+
+int main(int argc, char *argv[]) {
+	if (argc < 2) {
+		fprintf(stderr, "Usage: %s <input_markdown_file>\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	SourceDocument* doc = load_source_document(argv[1]);
+	if (!doc) {
+		perror("Failed to open file");
+		return EXIT_FAILURE;
+	}
+
+	printf("%s\n", doc->meta.excerpt ? doc->meta.excerpt : "");
+
+	free_source_document(doc);
+	return EXIT_SUCCESS;
+}
@@ -9,15 +9,6 @@
 #include "../../src/include/site_context.h"
 #include "../../src/include/dynamic_buffer.h"
 
-static void free_token_list(struct list_head* head) {
-	Token *current_token, *temp;
-	list_for_each_entry_safe(current_token, temp, head, list) {
-		list_del(&current_token->list);
-		if (current_token->value) free(current_token->value);
-		free(current_token);
-	}
-}
-
 int main(int argc, char *argv[]) {
 	if (argc < 2) {
 		fprintf(stderr, "Usage: %s <input_markdown_file>\n", argv[0]);
@@ -25,7 +16,7 @@ int main(int argc, char *argv[]) {
 	}
 	const char* input_filename = argv[1];
 
-	SiteContext* s_context = create_site_context(".");
+	SiteContext* s_context = create_site_context(".", NULL, NULL);
 	TemplateContext* t_context = create_template_context();
 
 	FILE* test_file = fopen(input_filename, "r");
@@ -43,20 +34,19 @@ int main(int argc, char *argv[]) {
 	fclose(test_file);
 	char* content_md = destroy_buffer_and_get_content(db);
 
-	LIST_HEAD(token_list);
-	tokenize_string(content_md, &token_list);
-	free(content_md);
-	AstNode* ast_root = parse_tokens(&token_list, s_context, input_filename);
+	TokenStream* tokens = create_token_stream(content_md);
+	Ast* ast = parse_tokens(tokens, s_context);
 
-	char* html_output = generate_html_from_ast(ast_root, t_context);
+	char* html_output = generate_html_from_ast(ast, t_context);
 
 	if (html_output) {
 		printf("%s", html_output);
 	}
 
 	free(html_output);
-	free_ast(ast_root);
-	free_token_list(&token_list);
+	free_ast(ast);
+	free_token_stream(tokens);
+	free(content_md);
 	free_site_context(s_context);
 	free_template_context(t_context);
 
@@ -2,21 +2,11 @@
 #include <stdlib.h>
 #include <stddef.h>
 
-#include "../../src/include/list_head.h"
 #include "../../src/include/tokenizer.h"
 #include "../../src/include/parser.h"
 #include "../../src/include/dynamic_buffer.h"
 
 
-static void free_token_list(struct list_head* head) {
-	Token *current_token, *temp;
-	list_for_each_entry_safe(current_token, temp, head, list) {
-		list_del(&current_token->list);
-		if (current_token->value) free(current_token->value);
-		free(current_token);
-	}
-}
-
 static const char* ast_node_type_to_string(AstNodeType type) {
 	switch (type) {
 		case NODE_DOCUMENT: return "DOCUMENT";
@@ -41,20 +31,18 @@ static const char* ast_node_type_to_string(AstNodeType type) {
 	}
 }
 
-static void print_ast_stdout(AstNode* node, int indent) {
+static void print_ast_stdout(const Ast* ast, AstNodeId id, int indent) {
+	const AstNode* node = ast_node(ast, id);
 	if (!node) return;
 	for (int i = 0; i < indent; ++i) fprintf(stdout, "\t");
 
 	fprintf(stdout, "-> %s", ast_node_type_to_string(node->type));
-	if (node->data1) fprintf(stdout, " | data1: \"%s\"", node->data1);
-	if (node->data2) fprintf(stdout, " | data2: \"%s\"", node->data2);
+	if (ast_data1(ast, node)) fprintf(stdout, " | data1: \"%s\"", ast_data1(ast, node));
+	if (ast_data2(ast, node)) fprintf(stdout, " | data2: \"%s\"", ast_data2(ast, node));
 	fprintf(stdout, "\n");
 
-	if (!list_empty(&node->children)) {
-		AstNode* child;
-		list_for_each_entry(child, &node->children, list) {
-			print_ast_stdout(child, indent + 1);
-		}
+	for (AstNodeId child = node->first_child; child != AST_NONE; child = ast->nodes[child].next_sibling) {
+		print_ast_stdout(ast, child, indent + 1);
 	}
 }
 
@@ -63,9 +51,8 @@ int main(int argc, char *argv[]) {
 		fprintf(stderr, "Usage: %s <input_markdown_file>\n", argv[0]);
 		return EXIT_FAILURE;
 	}
-	const char* input_filename = argv[1];
 
-	SiteContext* s_context = create_site_context(".");
+	SiteContext* s_context = create_site_context(".", NULL, NULL);
 	
 	// create test file
 	FILE* test_file = fopen(argv[1], "r");
@@ -83,18 +70,17 @@ int main(int argc, char *argv[]) {
 	char* content_md = destroy_buffer_and_get_content(db);
 
 	// run tokenizer
-	LIST_HEAD(token_list);
-	tokenize_string(content_md, &token_list);
+	TokenStream* tokens = create_token_stream(content_md);
 
 	// run parser
-	AstNode* ast_root = parse_tokens(&token_list, s_context, input_filename);
+	Ast* ast = parse_tokens(tokens, s_context);
 
 	// print AST
-	print_ast_stdout(ast_root, 0);
+	print_ast_stdout(ast, 0, 0);
 
 	// clean
-	free_token_list(&token_list);
-	free_ast(ast_root);
+	free_token_stream(tokens);
+	free_ast(ast);
 	free_site_context(s_context);
 
 	return EXIT_SUCCESS;
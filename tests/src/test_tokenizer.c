@@ -1,8 +1,8 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 
 #include "../../src/include/tokenizer.h"
-#include "../../src/include/list_head.h"
 
 const char* token_type_to_string(TokenType type) {
 	switch (type) {
@@ -27,26 +27,14 @@ const char* token_type_to_string(TokenType type) {
 	}
 }
 
-void print_tokens_to_stdout(struct list_head* head) {
-	Token* current_token;
-	list_for_each_entry(current_token, head, list) {
+void print_tokens_to_stdout(const TokenList* tokens) {
+	for (size_t i = 0; i < tokens->count; i++) {
+		const Token* current_token = &tokens->items[i];
 		fprintf(stdout, "[%s]", token_type_to_string(current_token->type));
-		if (current_token->value) {
-			fprintf(stdout, "{\"%s\"}", current_token->value);
-		} 
-		fprintf(stdout, "\n");
-	}
-}
-
-void free_tokens(struct list_head* head) {
-	Token *current_token, *temp;
-
-	list_for_each_entry_safe(current_token, temp, head, list) {
-		list_del(&current_token->list);
-		if (current_token->value) {
-			free(current_token->value);
+		if (current_token->type == TOKEN_TEXT || current_token->type == TOKEN_NUMBER) {
+			fprintf(stdout, "{\"%.*s\"}", (int)current_token->length, token_text(tokens->source, current_token));
 		}
-		free(current_token);
+		fprintf(stdout, "\n");
 	}
 }
 
@@ -62,13 +50,14 @@ int main(int argc, char* argv[]) {
 		return EXIT_FAILURE;
 	}
 
-	LIST_HEAD(token_list);
-	tokenize_file(test_file, &token_list);
+	TokenList token_list;
+	char* source = tokenize_file(test_file, &token_list);
 	fclose(test_file);
 
 	print_tokens_to_stdout(&token_list);
 
 	free_tokens(&token_list);
+	free(source);
 
 	return EXIT_SUCCESS;
 }